@@ -22,7 +22,8 @@ RM          = /bin/rm -f
 LN          = /bin/ln
 
 LIBS        =
-INCLUDES    =
+INCLUDES    = -I..
+CPPFLAGS    = $(INCLUDES)
 CFLAGS      = -O2 -Wall
 LDFLAGS     =
 
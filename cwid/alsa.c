@@ -44,6 +44,7 @@
 #include <alsa/asoundlib.h>
 #include "cwid.h"
 #include "alsa.h"
+#include "probes.h"
 
 snd_pcm_t *ph;
 
@@ -130,6 +131,7 @@ int alsa_write(int16_t **bf, int *nbf)
 
     /* Calculate number of samples */
     n = *nbf / 2;
+    PROBE1(cwid, alsa_write_entry, n);
 
     /* Write to sound device */
     //rc = snd_pcm_writei(ph, *bf, *nbf);
@@ -137,6 +139,7 @@ int alsa_write(int16_t **bf, int *nbf)
     if (rc < 0) {
         fprintf(stderr, "write error: %s\n", snd_strerror(rc));
     }
+    PROBE2(cwid, alsa_write_return, n, rc);
     return rc;
 }
 
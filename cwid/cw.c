@@ -35,29 +35,22 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <ctype.h>
 #include "cwid.h"
 #include "wave.h"
 #include "sound.h"
+#include "mixer.h"
+#include "morse.h"
 
 void text2code(char *cp);
 void code2snd(char *cd);
 int mktones(int wpm, int freq, int rate, int ampl, int atta, int deca);
 
 /* Global variables */
-static char *morse[] =
-    {".-","-...","-.-.","-..",".","..-.","--.",
-    "....","..",".---","-.-",".-..","--","-.","---",
-    ".--.","--.-",".-.","...","-","..-","...-",
-    ".--","-..-","-.--","--..",  /* A..Z */
-    "-----",".----","..---","...--","....-",
-    ".....","-....","--...","---..","----.", /* 0..9 */
-    "..--..","-..-.","S"}; /*  q-mark, slant, space */
-
 static char *usage =
     "Usage: cw [OPTION] [TEXT ...]\n"
     "Play morse code from command line.\n"
     "   -o      output method [alsa|dsp|stdout]\n"
+    "   -D      output device\n"
     "   -w      word per minute\n"
     "   -f      frequency in hertz\n"
     "   -r      sample rate in samples per second\n"
@@ -71,6 +64,7 @@ static char *usage =
 int         fd;
 int         outp = OUTDEFAULT;
 int         verbose = 0;
+int         ampl = AMPL;
 int16_t     *ditbf, *dahbf, *sgapbf, *lgapbf;
 int         nditbf, ndahbf, nsgapbf, nlgapbf;
 int         sditbf, sdahbf, ssgapbf, slgapbf;
@@ -80,9 +74,9 @@ int main(int argc, char *argv[])
     int     wpm  = WPM;
     int     freq = FREQ;
     int     rate = RATE;
-    int     ampl = AMPL;
     int     atta = ATTA;
     int     deca = DECA;
+    char    *dev = NULL;
 
     /* Get any optional command line args (start with -) */
     while (argc > 1 && *argv[1] == '-') {
@@ -94,7 +88,7 @@ int main(int argc, char *argv[])
                 outp = ALSA;
             else if (!strcmp(argv[2], "dsp"))
                 outp = DSP;
-            else if (!strcmp(argv[2], "alsa"))
+            else if (!strcmp(argv[2], "stdout"))
                 outp = STDOUT;
             else
                 outp = 0;
@@ -102,6 +96,9 @@ int main(int argc, char *argv[])
         if (!strcmp(argv[1], "-f")) { 
             freq = atoi(argv[2]); 
         }
+        if (!strcmp(argv[1], "-D")) { 
+            dev = argv[2]; 
+        }
         if (!strcmp(argv[1], "-r")) { 
             rate = atoi(argv[2]); 
         }
@@ -162,14 +159,15 @@ int main(int argc, char *argv[])
         return -1;
     }
 
-    /* Generate waveforms */
-    if (mktones(wpm, freq, rate, ampl, atta, deca)) {
+    /* Generate full scale waveforms, amplitude is applied at play time */
+    if (mktones(wpm, freq, rate, AMPL, atta, deca)) {
         return -1;
     }
 
     /* Setup DSP device */
-    sound_open(outp);
+    sound_open(outp, dev);
     sound_setup(rate, outp);
+    mix_init();
 
     if (verbose) fprintf(stderr, "Morse code: "); 
 
@@ -250,30 +248,17 @@ void text2code(char *tx)
     int     ch;
     char    *cd;
 
-    /* Break text into letters, calculate subscribt */
+    /* Break text into letters */
     while ((ch = *tx++) != '\0') {
-        if (isalpha(ch))
-            ch = toupper(ch);
-        if ((ch >= 'A') && (ch <= 'Z')) 
-            ch = ch - 65;
-        else if ((ch >= '0') && (ch <= '9')) 
-            ch = ch - 22;
-        else if (ch == '?') 
-            ch = 36;
-        else if (ch == '/') 
-            ch = 37;
-        else if (ch == ' ') 
-            ch = 38;
-        else
-            continue;
-
         /* Convert letter to code */
-        cd = morse[ch];
+        cd = morse_code(ch);
+        if (cd == NULL)
+            continue;
         code2snd(cd);
     }
 
     /* Insert space between words */
-    cd = morse[38];
+    cd = morse_code(' ');
     code2snd(cd);
 }
 
@@ -295,11 +280,11 @@ void code2snd(char *cd)
     while ((ch = *cd++) != '\0') {
         /* Send dit or dah tone, or space */
         if (ch == '.') {
-            w = sound_write(&ditbf, &nditbf, outp);
+            w = mix_write(ditbf, nditbf, ampl, outp);
             if (verbose) fprintf(stderr, ".");
         }
         if (ch == '-') {
-            w = sound_write(&dahbf, &ndahbf, outp);
+            w = mix_write(dahbf, ndahbf, ampl, outp);
             if (verbose) fprintf(stderr, "-");
         }
         if (ch == 'S') {
@@ -0,0 +1,208 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Play cached full scale renders, such as those written by `tones -o stdout'
+ * at its default -a 100, mixed together with a per file amplitude applied
+ * at play time. tones applies -a to what it writes, a lower one is baked in.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "cwid.h"
+#include "sound.h"
+#include "mixer.h"
+
+static char *usage =
+    "Usage: mix [OPTION] [FILE AMPLITUDE]...\n"
+    "Play up to %d cached full scale renders at once, each at its own amplitude.\n"
+    "Render them with `tones -o stdout -a 100', tones writes at its -a.\n"
+    "   -o      output method [alsa|dsp|stdout]\n"
+    "   -D      output device\n"
+    "   -r      sample rate in samples per second\n"
+    "   -k      duck the other files to amplitude in % while the first plays\n"
+    "   -v      clutter the screen\n"
+    "   -h      display this help and exit\n"
+    "Copyright (c) 2026, Adi Linden <adi@adis.ca>\n";
+
+int16_t *readraw(char *name, int *sbf);
+
+int main(int argc, char *argv[])
+{
+    int     i, w;
+    int     outp = OUTDEFAULT;
+    char    *dev = NULL;
+    int     rate = RATE;
+    int     duck = MAXAMPL;
+    int     verbose = 0;
+    int     nf = 0;
+    char    *name[MIXSRCS];
+    int     ampl[MIXSRCS];
+    int16_t *bf[MIXSRCS];
+    int     sbf[MIXSRCS];
+
+    /* Get any optional command line args (start with -) */
+    while (argc > 1 && *argv[1] == '-') {
+        if (!strcmp(argv[1], "-o")) {
+            if (!strcmp(argv[2], "alsa"))
+                outp = ALSA;
+            else if (!strcmp(argv[2], "dsp"))
+                outp = DSP;
+            else if (!strcmp(argv[2], "stdout"))
+                outp = STDOUT;
+            else
+                outp = 0;
+        }
+        if (!strcmp(argv[1], "-D")) { 
+            dev = argv[2]; 
+        }
+        if (!strcmp(argv[1], "-r")) { 
+            rate = atoi(argv[2]); 
+        }
+        if (!strcmp(argv[1], "-k")) { 
+            duck = atoi(argv[2]); 
+        }
+        if (!strcmp(argv[1], "-h")) { 
+            fprintf(stderr, usage, MIXSRCS);
+            return -1;
+        }
+        if (!strcmp(argv[1], "-v")) { 
+            verbose = 1; 
+            ++argc;     /* Offset for lack of value */
+            --argv;     /* Needs to be last test!   */
+        }
+        argc -= 2;
+        argv += 2;
+    }
+
+    /* Get mandatory file(s) */
+    while (argc > 2) {
+        if (nf >= MIXSRCS) {
+            fprintf(stderr, "Too many files specified\n");
+            fprintf(stderr, usage, MIXSRCS);
+            return -1;
+        }
+        name[nf] = argv[1];
+        ampl[nf] = atoi(argv[2]);
+        argc -= 2;
+        argv += 2;
+        ++nf;
+    }
+
+    /* Sanity check of input values */
+    if (nf < 1) {
+        fprintf(stderr, "No files specified\n");
+        fprintf(stderr, usage, MIXSRCS);
+        return -1;
+    }
+    if (outp < 1) {
+        fprintf(stderr, "Output format needs to be alsa, dsp, or stdout\n");
+        return -1;
+    }
+    if (rate < MINRATE || rate > MAXRATE) {
+        fprintf(stderr, "Support %d to %d samples per second\n",
+                MINRATE, MAXRATE);
+        return -1;
+    }
+    if (duck < MINAMPL || duck > MAXAMPL) {
+        fprintf(stderr, "Support %d to %d ducking amplitude\n",
+                MINAMPL, MAXAMPL);
+        return -1;
+    }
+    for (i = 0; i < nf; ++i) {
+        if (ampl[i] < MINAMPL || ampl[i] > MAXAMPL) {
+            fprintf(stderr, "Support %d to %d amplitude\n",
+                    MINAMPL, MAXAMPL);
+            return -1;
+        }
+    }
+
+    /* Load the renders */
+    for (i = 0; i < nf; ++i) {
+        bf[i] = readraw(name[i], &sbf[i]);
+        if (bf[i] == NULL) {
+            fprintf(stderr, "Unable to read %s\n", name[i]);
+            return -1;
+        }
+        if (verbose) fprintf(stderr, "File %s: %d samples at %d%%\n",
+                            name[i], sbf[i], ampl[i]);
+    }
+
+    /* Open sound device and setup sampling parameters*/
+    sound_open(outp, dev);
+    sound_setup(rate, outp);
+
+    /* The first file ducks all others */
+    mix_init();
+    mix_ducking(duck);
+    for (i = 0; i < nf; ++i)
+        mix_add(bf[i], sbf[i], ampl[i], i == 0 && duck < MAXAMPL);
+
+    w = mix_play(outp);
+    if (verbose) fprintf(stderr, "Wrote %d bytes\n", w);
+
+    /* Exit clean */
+    for (i = 0; i < nf; ++i)
+        free(bf[i]);
+    sound_close(outp);
+    return 0;
+}
+
+/* readraw
+ * Reads a file of raw 16 bit samples into a newly allocated buffer.
+ * Returns the buffer and the number of samples in sbf, NULL on failure.
+ */
+int16_t *readraw(char *name, int *sbf)
+{
+    FILE    *f;
+    int16_t *bf;
+    long    sz;
+
+    f = fopen(name, "rb");
+    if (f == NULL)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    sz = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (sz < 2) {
+        fclose(f);
+        return NULL;
+    }
+
+    bf = malloc(sz);
+    if (bf == NULL) {
+        fclose(f);
+        return NULL;
+    }
+    *sbf = fread(bf, 2, sz / 2, f);
+    fclose(f);
+    return bf;
+}
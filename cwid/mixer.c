@@ -0,0 +1,262 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Mix several full scale sources with play time gain and ducking
+ *
+ * The inner loops use saturating 16 bit arithmetic. SSE2 and NEON versions
+ * are used when the compiler targets them, a portable version otherwise.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cwid.h"
+#include "sound.h"
+#include "mixer.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static struct mixsrc src[MIXSRCS];
+static int duckgain = MIXUNITY;     /* Gain of others while ducked */
+static int duckcur = MIXUNITY;      /* Current, ramped duck gain */
+
+/* mix_init
+ * Drops all sources and resets ducking.
+ */
+void mix_init()
+{
+    memset(src, 0, sizeof(src));
+    duckgain = MIXUNITY;
+    duckcur = MIXUNITY;
+}
+
+/* mix_q15
+ * Converts an amplitude in percent into a Q15 gain.
+ */
+int mix_q15(int ampl)
+{
+    if (ampl < MINAMPL)
+        ampl = MINAMPL;
+    if (ampl > MAXAMPL)
+        ampl = MAXAMPL;
+    return ampl * MIXUNITY / 100;
+}
+
+/* mix_add
+ * Adds a full scale buffer of sbf samples to be played at ampl percent.
+ * If duck is set all other sources are lowered while this one plays.
+ * The buffer is not copied and must stay valid until played.
+ * Returns the source id or -1 if all slots are busy.
+ */
+int mix_add(int16_t *bf, int sbf, int ampl, int duck)
+{
+    int i;
+
+    for (i = 0; i < MIXSRCS; ++i) {
+        if (src[i].bf == NULL) {
+            src[i].bf = bf;
+            src[i].sbf = sbf;
+            src[i].pos = 0;
+            src[i].gain = mix_q15(ampl);
+            src[i].duck = duck;
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* mix_gain
+ * Changes the gain of a playing source, effective with the next block.
+ */
+void mix_gain(int id, int ampl)
+{
+    if (id >= 0 && id < MIXSRCS)
+        src[id].gain = mix_q15(ampl);
+}
+
+/* mix_ducking
+ * Sets the amplitude in percent applied to all other sources while a
+ * ducking source plays.
+ */
+void mix_ducking(int ampl)
+{
+    duckgain = mix_q15(ampl);
+}
+
+/* mix_active
+ * Returns the number of sources with samples left to play.
+ */
+int mix_active()
+{
+    int i, n = 0;
+
+    for (i = 0; i < MIXSRCS; ++i)
+        if (src[i].bf != NULL)
+            ++n;
+    return n;
+}
+
+/* mix_scale
+ * Copies n samples from src to dst scaled by a Q15 gain.
+ */
+void mix_scale(int16_t *dst, const int16_t *s, int n, int gain)
+{
+    int i = 0;
+
+#if defined(__SSE2__)
+    __m128i g = _mm_set1_epi16(gain);
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i lo = _mm_mullo_epi16(x, g);
+        __m128i hi = _mm_mulhi_epi16(x, g);
+        __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15);
+        __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(a, b));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8)
+        vst1q_s16(dst + i, vqrdmulhq_n_s16(vld1q_s16(s + i), gain));
+#endif
+    for (; i < n; ++i)
+        dst[i] = ((int32_t)s[i] * gain) >> 15;
+}
+
+/* mix_sum
+ * Adds n samples from src onto dst, saturating at full scale.
+ */
+void mix_sum(int16_t *dst, const int16_t *s, int n)
+{
+    int i = 0;
+    int32_t v;
+
+#if defined(__SSE2__)
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(s + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_adds_epi16(a, b));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8)
+        vst1q_s16(dst + i, vqaddq_s16(vld1q_s16(dst + i), vld1q_s16(s + i)));
+#endif
+    for (; i < n; ++i) {
+        v = (int32_t)dst[i] + s[i];
+        if (v > INT16_MAX)
+            v = INT16_MAX;
+        if (v < INT16_MIN)
+            v = INT16_MIN;
+        dst[i] = v;
+    }
+}
+
+/* mix_run
+ * Mixes up to n samples of all active sources into out. Sources are
+ * dropped once played completely.
+ * Returns the number of samples placed in out, 0 when nothing is left.
+ */
+int mix_run(int16_t *out, int n)
+{
+    int16_t tmp[MIXBLK];
+    int     i, k, m, gain;
+    int     ducked = 0;
+    int     len = 0;
+
+    if (n > MIXBLK)
+        n = MIXBLK;
+
+    /* Ramp the duck gain to avoid clicks */
+    for (i = 0; i < MIXSRCS; ++i)
+        if (src[i].bf != NULL && src[i].duck)
+            ducked = 1;
+    k = ducked ? duckgain : MIXUNITY;
+    if (duckcur < k)
+        duckcur = (k - duckcur > MIXDUCKSTEP) ? duckcur + MIXDUCKSTEP : k;
+    if (duckcur > k)
+        duckcur = (duckcur - k > MIXDUCKSTEP) ? duckcur - MIXDUCKSTEP : k;
+
+    memset(out, 0, n * sizeof(int16_t));
+    for (i = 0; i < MIXSRCS; ++i) {
+        if (src[i].bf == NULL)
+            continue;
+
+        m = src[i].sbf - src[i].pos;
+        if (m > n)
+            m = n;
+        gain = src[i].gain;
+        if (!src[i].duck)
+            gain = gain * duckcur / MIXUNITY;
+
+        mix_scale(tmp, src[i].bf + src[i].pos, m, gain);
+        mix_sum(out, tmp, m);
+        if (m > len)
+            len = m;
+
+        src[i].pos += m;
+        if (src[i].pos >= src[i].sbf)
+            src[i].bf = NULL;
+    }
+    return len;
+}
+
+/* mix_play
+ * Mixes all active sources and writes them to the output until done.
+ * Returns the number of bytes written or -1 on failure.
+ */
+int mix_play(int outp)
+{
+    int16_t blk[MIXBLK];
+    int16_t *bf = blk;
+    int     n, nbf;
+    int     w = 0;
+
+    while ((n = mix_run(blk, MIXBLK)) > 0) {
+        nbf = n * 2;
+        if (sound_write(&bf, &nbf, outp) < 0)
+            return -1;
+        w += nbf;
+    }
+    return w;
+}
+
+/* mix_write
+ * Plays a single full scale buffer of nbf bytes at ampl percent, together
+ * with whatever else is active.
+ * Returns the number of bytes written or -1 on failure.
+ */
+int mix_write(int16_t *bf, int nbf, int ampl, int outp)
+{
+    if (mix_add(bf, nbf / 2, ampl, 0) < 0)
+        return -1;
+    return mix_play(outp);
+}
@@ -0,0 +1,64 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This header file defines constants and functions specific to mixing
+ * several full scale waveforms into a single output stream.
+ *
+ * Waveforms are rendered at full scale (AMPL) and the amplitude is applied
+ * as a gain at play time. A cached render can thus be reused at any volume
+ * and any number of sources can overlap, such as a courtesy tone on top of
+ * an announcement.
+ */
+
+#define MIXSRCS     8           /* Max number of sources mixed at once */
+#define MIXBLK      1024        /* Samples mixed per block */
+#define MIXUNITY    32767       /* Unity gain in Q15 fixed point */
+#define MIXDUCKSTEP 4096        /* Max duck gain change per block (Q15) */
+
+struct mixsrc {
+    int16_t *bf;                /* Full scale samples */
+    int     sbf;                /* Number of samples in buffer */
+    int     pos;                /* Next sample to be mixed */
+    int     gain;               /* Play time gain in Q15 */
+    int     duck;               /* Source ducks all others while playing */
+};
+
+void mix_init();
+int  mix_add(int16_t *bf, int sbf, int ampl, int duck);
+void mix_gain(int id, int ampl);
+void mix_ducking(int ampl);
+int  mix_active();
+int  mix_run(int16_t *out, int n);
+int  mix_play(int outp);
+int  mix_write(int16_t *bf, int nbf, int ampl, int outp);
+int  mix_q15(int ampl);
+void mix_scale(int16_t *dst, const int16_t *src, int n, int gain);
+void mix_sum(int16_t *dst, const int16_t *src, int n);
+
@@ -0,0 +1,64 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <ctype.h>
+#include "morse.h"
+
+static char *morse[] =
+    {".-","-...","-.-.","-..",".","..-.","--.",
+    "....","..",".---","-.-",".-..","--","-.","---",
+    ".--.","--.-",".-.","...","-","..-","...-",
+    ".--","-..-","-.--","--..",  /* A..Z */
+    "-----",".----","..---","...--","....-",
+    ".....","-....","--...","---..","----.", /* 0..9 */
+    "..--..","-..-.","S"}; /*  q-mark, slant, space */
+
+/* morse_code
+ * Returns the string of . and - of a letter, "S" for a space between
+ * words or NULL for a character we have no code for.
+ */
+char *morse_code(int ch)
+{
+    if (isalpha(ch))
+        ch = toupper(ch);
+    if ((ch >= 'A') && (ch <= 'Z')) 
+        ch = ch - 65;
+    else if ((ch >= '0') && (ch <= '9')) 
+        ch = ch - 22;
+    else if (ch == '?') 
+        ch = 36;
+    else if (ch == '/') 
+        ch = 37;
+    else if (ch == ' ') 
+        ch = 38;
+    else
+        return NULL;
+    return morse[ch];
+}
@@ -39,14 +39,15 @@
 #include "stdout.h"
 #include "sound.h"
 
-void sound_open(int outp)
+/* Open the output, dev selects a device other than the default */
+void sound_open(int outp, char *dev)
 {
     switch (outp) {
         case ALSA:
-            alsa_open(DEVALSA);
+            alsa_open(dev ? dev : DEVALSA);
             break;
         case DSP:
-            dsp_open(DEVDSP);
+            dsp_open(dev ? dev : DEVDSP);
             break;
         case STDOUT:
             stdout_open(DEVDSP);
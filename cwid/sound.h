@@ -27,7 +27,7 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-void sound_open(int outp);
+void sound_open(int outp, char *dev);
 void sound_setup(int rate, int outp);
 int  sound_write(int16_t **bf, int *nbf, int outp);
 void sound_close(int outp);
@@ -38,6 +38,7 @@ static char *usage =
     "Usage: test [OPTION]...\n"
     "Tone generating test\n"
     "   -o      output method [alsa|dsp|stdout]\n"
+    "   -D      output device\n"
     "   -f      frequency in Hz\n"
     "   -r      sample rate in samples per second\n"
     "   -a      amplitude in %\n"
@@ -50,6 +51,7 @@ static char *usage =
 int main(int argc, char *argv[])
 {
     int     outp = OUTDEFAULT;
+    char    *dev = NULL;
     int     freq = FREQ;
     int     rate = RATE;
     int     ampl = AMPL;
@@ -75,6 +77,9 @@ int main(int argc, char *argv[])
         if (!strcmp(argv[1], "-f")) { 
             freq = atoi(argv[2]); 
         }
+        if (!strcmp(argv[1], "-D")) { 
+            dev = argv[2]; 
+        }
         if (!strcmp(argv[1], "-r")) { 
             rate = atoi(argv[2]); 
         }
@@ -125,7 +130,7 @@ int main(int argc, char *argv[])
     }
 
     /* Open sound device and setup sampling parameters*/
-    sound_open(outp);
+    sound_open(outp, dev);
     sound_setup(rate, outp);
 
     /* Tell about what we are doing */
@@ -33,11 +33,13 @@
 #include "cwid.h"
 #include "wave.h"
 #include "sound.h"
+#include "mixer.h"
 
 static char *usage =
     "Usage: tones [OPTION] [FREQUENCY DURATION SPACE]...\n"
     "Generate a sequence of tones, up to %d tones may be specified.\n"
     "   -o      output method [alsa|dsp|stdout]\n"
+    "   -D      output device\n"
     "   -r      sample rate in samples per second\n"
     "   -a      amplitude in %\n"
     "   -da     attack in milliseconds\n"
@@ -50,6 +52,7 @@ int main(int argc, char *argv[])
 {
     int     i, w;
     int     outp = OUTDEFAULT;
+    char    *dev = NULL;
     int     rate = RATE;
     int     ampl = AMPL;
     int     atta = ATTA;
@@ -70,11 +73,14 @@ int main(int argc, char *argv[])
                 outp = ALSA;
             else if (!strcmp(argv[2], "dsp"))
                 outp = DSP;
-            else if (!strcmp(argv[2], "alsa"))
+            else if (!strcmp(argv[2], "stdout"))
                 outp = STDOUT;
             else
                 outp = 0;
         }
+        if (!strcmp(argv[1], "-D")) { 
+            dev = argv[2]; 
+        }
         if (!strcmp(argv[1], "-r")) { 
             rate = atoi(argv[2]); 
         }
@@ -159,7 +165,7 @@ int main(int argc, char *argv[])
     }
 
     /* Open sound device and setup sampling parameters*/
-    sound_open(outp);
+    sound_open(outp, dev);
     sound_setup(rate, outp);
 
     /* Tell about what we are doing */
@@ -186,8 +192,8 @@ int main(int argc, char *argv[])
     /* Generate each tone */
     for (i=0; i<nt; ++i) {
 
-        /* Generate tone */
-        stonbf = mkwave(freq[i], rate, ampl, dura[i], atta, deca, &tonbf, &ntonbf);
+        /* Generate full scale tone, amplitude is applied at play time */
+        stonbf = mkwave(freq[i], rate, AMPL, dura[i], atta, deca, &tonbf, &ntonbf);
         if (stonbf < 0) {
             fprintf(stderr, "Waveform generation failed\n");
             return -1;
@@ -218,8 +224,9 @@ int main(int argc, char *argv[])
         free(spcbf);
     }
 
-    /* Write buffer to device */
-    w = sound_write(&bigbf, &nbigbf, outp);
+    /* Write buffer to device at the requested amplitude */
+    mix_init();
+    w = mix_write(bigbf, nbigbf, ampl, outp);
     if (verbose) fprintf(stderr, "Wrote %d bytes for buffer of %d samples (%d bytes)\n", 
                         w, sbigbf, nbigbf);
 
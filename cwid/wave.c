@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include "wave.h"
+#include "probes.h"
 
 /* mkwave
  *
@@ -46,6 +47,8 @@ int mkwave(int freq, int rate, int ampl, int dura, int atta, int deca,
     int     i;
     int     a;
 
+    PROBE3(cwid, mkwave_start, freq, rate, dura);
+
     /* Calculate number of samples needed */
     st = (double)rate * dura / 1000;    /* total samples */
     sa = (double)rate * atta / 1000;    /* attack samples */
@@ -79,6 +82,7 @@ int mkwave(int freq, int rate, int ampl, int dura, int atta, int deca,
     /* return buffer and end function */
     *bf = tbf;
     *nbf = ntbf;
+    PROBE2(cwid, mkwave_end, freq, st);
     return st;
 }
 
@@ -0,0 +1,63 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Static tracepoints
+ *
+ * With <sys/sdt.h> (systemtap-sdt-dev or similar) installed the PROBE
+ * macros place USDT probes that perf and bpftrace attach to on a running
+ * process, e.g.
+ *
+ *   bpftrace -e 'usdt:./repeater:repeater:ppclaim_return { ... }'
+ *
+ * A probe not in use costs a nop. Without the header, or when built with
+ * -DNO_PROBES, the probes compile to nothing. Arguments must be integers
+ * or pointers.
+ */
+
+#if !defined(NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HAVE_PROBES
+#endif
+#endif
+
+#ifdef HAVE_PROBES
+#define PROBE(p, n)                 DTRACE_PROBE(p, n)
+#define PROBE1(p, n, a)             DTRACE_PROBE1(p, n, a)
+#define PROBE2(p, n, a, b)          DTRACE_PROBE2(p, n, a, b)
+#define PROBE3(p, n, a, b, c)       DTRACE_PROBE3(p, n, a, b, c)
+#define PROBE4(p, n, a, b, c, d)    DTRACE_PROBE4(p, n, a, b, c, d)
+#else
+#define PROBE(p, n)                 do { } while (0)
+#define PROBE1(p, n, a)             do { } while (0)
+#define PROBE2(p, n, a, b)          do { } while (0)
+#define PROBE3(p, n, a, b, c)       do { } while (0)
+#define PROBE4(p, n, a, b, c, d)    do { } while (0)
+#endif
@@ -0,0 +1,332 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "cwid/morse.h"
+#include "irlpdev.h"
+#include "portctl_lib.h"
+#include "stats.h"
+#include "log.h"
+#include "pwm.h"
+#include "beacon.h"
+
+#define BEACONEDGES (BEACONTEXT * 12) /* Six elements to a letter */
+
+/* A port as the beacon thread sees it, with a handle of its own */
+struct beaconport {
+    struct irlpdev  dev;
+    int             id;
+    unsigned char   pin;
+    uint64_t        unit;       /* ns */
+    uint64_t        every;      /* ns from the start of a send to the next */
+    uint32_t        at[BEACONEDGES];    /* Units from the start of a send,
+                                         * key down at even, up at odd */
+    int             n;
+    uint32_t        len;        /* Units of a send and the word gap after */
+    int             next;       /* Key change due */
+    uint64_t        start;      /* Of the send, ns */
+    int64_t         late;       /* Of the last key change, ns */
+    int             paused;     /* While the port is out of service */
+    struct beaconstats *st;
+};
+
+static struct beaconport *beacons[MAXPORTS];    /* By port id */
+static struct beaconport beaconports[MAXPORTS];
+static int nbeacons = 0;
+static pthread_t sender;
+static int running = 0;
+
+/* Nanoseconds of a monotonic clock */
+static uint64_t mono_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Compile text into the key changes of a send. Characters without a code
+ * are skipped. Returns the number of key changes or -1.
+ */
+static int beacon_compile(struct beaconport *b, const char *text)
+{
+    uint32_t u = 0, gap = 0;
+    char *cd;
+
+    b->n = 0;
+    for (; *text != '\0'; ++text) {
+        if ((cd = morse_code(*text)) == NULL)
+            continue;
+        if (*cd == 'S') {
+            if (b->n)
+                gap = 7;
+            continue;
+        }
+        for (; *cd != '\0'; ++cd) {
+            if (b->n + 2 > BEACONEDGES)
+                return -1;
+            u += gap;
+            b->at[b->n++] = u;
+            u += *cd == '-' ? 3 : 1;
+            b->at[b->n++] = u;
+            gap = 1;
+        }
+        gap = 3;
+    }
+    b->len = u + 7;
+    return b->n ? b->n : -1;
+}
+
+/*
+ * Open a second handle to a port with a beacon and compile its text
+ */
+int beacon_add(struct port *p, struct beaconstats *st)
+{
+    struct beaconport *b;
+
+    if (!p->beacon.pin || nbeacons >= MAXPORTS || p->id >= MAXPORTS)
+        return -1;
+    b = &beaconports[nbeacons];
+    if (beacon_compile(b, p->beacon.text) < 0)
+        return -1;
+    if (irlpdev_dup(&p->dev, &b->dev) < 0)
+        return -1;
+    b->dev.quiet = 1;
+    b->id = p->id;
+    b->pin = p->beacon.pin;
+    b->unit = 1200000000ULL / p->beacon.wpm;
+    b->every = (uint64_t)p->beacon.every * 1000000000;
+    b->paused = 0;
+    b->st = st;
+    memset(st, 0, sizeof(*st));
+    st->wpm = p->beacon.wpm;
+    st->unitus = b->unit / 1000;
+    beacons[p->id] = b;
+    ++nbeacons;
+    return 0;
+}
+
+/* Key down or up, under the mutex of the port */
+static int beacon_key(struct beaconport *b, int down, int64_t *late,
+                      uint64_t due)
+{
+    unsigned char c[2];
+    int k;
+
+    pwm_begin(b->id);
+    if (__atomic_load_n(&b->paused, __ATOMIC_ACQUIRE)) {
+        pwm_end(b->id);
+        return 1;
+    }
+    k = modify_irlpdev(&b->dev, down ? b->pin : 0, down ? 0 : b->pin, c);
+    *late = mono_ns() - due;
+    pwm_end(b->id);
+    return k == 2 ? 0 : -1;
+}
+
+/*
+ * Key up and leave the beacon of a port alone while it is out of service,
+ * its handle is closed so the device can go. Returns -1 if the port has
+ * no beacon here or it was paused already, the pin is the caller's then.
+ */
+int beacon_pause(int id)
+{
+    struct beaconport *b = beacons[id];
+    unsigned char c[2];
+
+    if (b == NULL || __atomic_load_n(&b->paused, __ATOMIC_ACQUIRE))
+        return -1;
+    pwm_begin(b->id);
+    __atomic_store_n(&b->paused, 1, __ATOMIC_RELEASE);
+    modify_irlpdev(&b->dev, 0, b->pin, c);
+    irlpdev_close(&b->dev);
+    pwm_end(b->id);
+    return 0;
+}
+
+/*
+ * The port is back, open the handle again and start over with a new send
+ */
+void beacon_resume(struct port *p)
+{
+    struct beaconport *b = beacons[p->id];
+
+    if (b == NULL || !__atomic_load_n(&b->paused, __ATOMIC_ACQUIRE))
+        return;
+    pwm_begin(b->id);
+    if (irlpdev_redup(&p->dev, &b->dev) >= 0) {
+        b->start = mono_ns() + 100000000;
+        b->next = 0;
+        b->late = 0;
+        __atomic_store_n(&b->paused, 0, __ATOMIC_RELEASE);
+    }
+    pwm_end(b->id);
+}
+
+/*
+ * Write the key change due and count how it came out. After the last one
+ * the next send is due every seconds after this one started, or right
+ * after the word gap. A send that is overdue starts now.
+ */
+static void beacon_step(struct beaconport *b, uint64_t due)
+{
+    struct beaconstats *st = b->st;
+    uint64_t len, now;
+    int64_t late, err;
+    int k;
+
+    if ((k = beacon_key(b, !(b->next & 1), &late, due)) > 0)
+        return;                 /* Paused, beacon_resume starts over */
+    if (k < 0) {
+        st->errors++;
+    } else {
+        if (late < 0)
+            late = 0;
+        st->edges++;
+        st->lateus += late / 1000;
+        if ((uint64_t)late / 1000 > st->maxlateus)
+            st->maxlateus = late / 1000;
+        if (late > BEACONLATE * 1000)
+            st->late++;
+        err = late - b->late;
+        if (err < 0)
+            err = -err;
+        if (b->next && (uint64_t)err / 1000 > st->maxerrus)
+            st->maxerrus = err / 1000;
+        b->late = late;
+    }
+
+    if (++b->next < b->n)
+        return;
+    len = b->len * b->unit;
+    b->start += b->every > len ? b->every : len;
+    now = mono_ns();
+    if (b->start < now)
+        b->start = now;
+    b->next = 0;
+    st->sends++;
+}
+
+/*
+ * The beacon thread
+ */
+static void *beacon_send(void *arg)
+{
+    struct beaconport *b;
+    struct timespec ts;
+    uint64_t now, due, wake;
+    int i;
+
+    while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        b = NULL;
+        due = 0;
+        for (i = 0; i < nbeacons; ++i) {
+            if (__atomic_load_n(&beaconports[i].paused, __ATOMIC_ACQUIRE))
+                continue;
+            wake = beaconports[i].start +
+                   beaconports[i].at[beaconports[i].next] *
+                   beaconports[i].unit;
+            if (b == NULL || wake < due) {
+                b = &beaconports[i];
+                due = wake;
+            }
+        }
+
+        /* Sleep to shortly before the change, looking at running now
+         * and then
+         */
+        now = mono_ns();
+        if (b == NULL)
+            due = now + 100000000 + BEACONSPIN * 1000;
+        if (due > now + BEACONSPIN * 1000) {
+            wake = due - BEACONSPIN * 1000;
+            if (wake > now + 100000000)
+                wake = now + 100000000;
+            ts.tv_sec = wake / 1000000000;
+            ts.tv_nsec = wake % 1000000000;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+            continue;
+        }
+        while (mono_ns() < due)
+            ;
+        beacon_step(b, due);
+    }
+    return NULL;
+}
+
+/*
+ * Start the thread, at a realtime priority above the PWM if we may. Every
+ * beacon starts over with a new send.
+ */
+int beacon_start()
+{
+    struct sched_param sp;
+    uint64_t now;
+    int i;
+
+    if (!nbeacons)
+        return 0;
+    now = mono_ns() + 100000000;
+    for (i = 0; i < nbeacons; ++i) {
+        beaconports[i].start = now;
+        beaconports[i].next = 0;
+        beaconports[i].late = 0;
+    }
+    running = 1;
+    if (pthread_create(&sender, NULL, beacon_send, NULL)) {
+        running = 0;
+        return -1;
+    }
+    sp.sched_priority = sched_get_priority_min(SCHED_FIFO) + 1;
+    if (pthread_setschedparam(sender, SCHED_FIFO, &sp))
+        do_log("Beacon: no realtime priority, expect more jitter");
+    return 0;
+}
+
+/*
+ * Stop the thread and leave the keys up
+ */
+void beacon_stop()
+{
+    int64_t late;
+    int i;
+
+    if (!running)
+        return;
+    __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+    pthread_join(sender, NULL);
+    for (i = 0; i < nbeacons; ++i)
+        beacon_key(&beaconports[i], 0, &late, mono_ns());
+}
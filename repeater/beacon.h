@@ -0,0 +1,60 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * CW beacon
+ *
+ * Keys AUX5 of a port in Morse code, for a second transmitter that sends
+ * the beacon as a keyed carrier, no audio involved. The text is compiled
+ * once into the times of its key changes, counted in units with the PARIS
+ * timing of cw: a dit is one unit and a dah three, the gap within a letter
+ * is one, between letters three and between words seven. At w words per
+ * minute a unit is 1200 / w ms.
+ *
+ * A thread of its own sends the beacon of every port through handles of
+ * its own, under the same port mutex as the PWM. Each key change is due
+ * at an absolute time from the start of the send, so late wakeups do not
+ * add up. The thread sleeps until BEACONSPIN before a change and spins the
+ * rest of the way. How late each change was written and how far each
+ * element or gap came out from its length are kept in the beaconstats of
+ * the port.
+ *
+ * While its port is out of service a beacon is paused with the key up,
+ * and once the port is back it starts over with a new send through a
+ * handle opened again.
+ */
+
+#define BEACONLATE  1000        /* A key change this many us late is counted */
+#define BEACONSPIN  200         /* Spin this many us before a key change */
+
+int  beacon_add(struct port *p, struct beaconstats *st);
+int  beacon_start();
+int  beacon_pause(int id);
+void beacon_resume(struct port *p);
+void beacon_stop();
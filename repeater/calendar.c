@@ -0,0 +1,276 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include "calendar.h"
+
+/* Range of each time field */
+static struct {
+    char    *name;
+    int     min;
+    int     max;
+} fields[5] = {
+    { "minute", 0, 59 }, { "hour", 0, 23 }, { "day", 1, 31 },
+    { "month", 1, 12 }, { "weekday", 0, 7 }
+};
+
+/*
+ * Turn a field such as 0-30/10,45 into a bit mask. Returns -1 if it does
+ * not parse or goes out of range.
+ */
+static int cal_field(char *spec, int f, uint64_t *mask)
+{
+    char *item, *save, *end;
+    long lo, hi, step, v;
+
+    *mask = 0;
+    for (item = strtok_r(spec, ",", &save); item != NULL;
+            item = strtok_r(NULL, ",", &save)) {
+        step = 1;
+        if (*item == '*') {
+            lo = fields[f].min;
+            hi = fields[f].max;
+            end = item + 1;
+        } else {
+            lo = hi = strtol(item, &end, 10);
+            if (end == item)
+                return -1;
+            if (*end == '-') {
+                item = end + 1;
+                hi = strtol(item, &end, 10);
+                if (end == item)
+                    return -1;
+            }
+        }
+        if (*end == '/') {
+            item = end + 1;
+            step = strtol(item, &end, 10);
+            if (end == item || step < 1)
+                return -1;
+        }
+        if (*end != '\0' || lo < fields[f].min || hi > fields[f].max ||
+                lo > hi)
+            return -1;
+        for (v = lo; v <= hi; v += step)
+            *mask |= 1ULL << v;
+    }
+    return *mask ? 0 : -1;
+}
+
+static int cal_day(struct calrule *r, struct tm *tm)
+{
+    int day = (r->day >> tm->tm_mday) & 1;
+    int wday = (r->wday >> tm->tm_wday) & 1;
+
+    if (r->anyday || r->anywday)
+        return day && wday;
+    return day || wday;
+}
+
+/*
+ * The first time after t the rule fires, or -1 if it never does. Each
+ * field that does not match skips ahead to the start of the next value of
+ * that field, so a year takes a few hundred steps at most.
+ */
+static time_t cal_after(struct calrule *r, time_t t)
+{
+    struct tm tm;
+    int i;
+
+    t = t - t % 60 + 60;
+    localtime_r(&t, &tm);
+    for (i = 0; i < 5000; ++i) {
+        if (!((r->month >> (tm.tm_mon + 1)) & 1)) {
+            tm.tm_mon++;
+            tm.tm_mday = 1;
+            tm.tm_hour = 0;
+            tm.tm_min = 0;
+        } else if (!cal_day(r, &tm)) {
+            tm.tm_mday++;
+            tm.tm_hour = 0;
+            tm.tm_min = 0;
+        } else if (!((r->hour >> tm.tm_hour) & 1)) {
+            tm.tm_hour++;
+            tm.tm_min = 0;
+        } else if (!((r->min >> tm.tm_min) & 1)) {
+            tm.tm_min++;
+        } else {
+            return t;
+        }
+        tm.tm_sec = 0;
+        tm.tm_isdst = -1;
+        t = mktime(&tm);
+        localtime_r(&t, &tm);
+    }
+    return -1;
+}
+
+static void cal_swap(struct calendar *s, int a, int b)
+{
+    struct calent e = s->heap[a];
+
+    s->heap[a] = s->heap[b];
+    s->heap[b] = e;
+}
+
+static void cal_push(struct calendar *s, time_t at, int rule)
+{
+    int i = s->n++;
+
+    s->heap[i].at = at;
+    s->heap[i].rule = rule;
+    while (i > 0 && s->heap[(i - 1) / 2].at > s->heap[i].at) {
+        cal_swap(s, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void cal_down(struct calendar *s, int i)
+{
+    int c;
+
+    while ((c = 2 * i + 1) < s->n) {
+        if (c + 1 < s->n && s->heap[c + 1].at < s->heap[c].at)
+            ++c;
+        if (s->heap[i].at <= s->heap[c].at)
+            break;
+        cal_swap(s, i, c);
+        i = c;
+    }
+}
+
+/*
+ * Read the rules and schedule them from now on. A file that does not
+ * exist is an empty schedule. On any error s is left alone and -1
+ * returned, the reason goes to stderr. Returns the number of rules.
+ */
+int cal_load(struct calendar *s, const char *path, time_t now)
+{
+    struct calendar ns;
+    struct calrule *r;
+    char line[256], *tok[6], *p, *save;
+    uint64_t m[5];
+    time_t at;
+    int n = 0, i;
+    FILE *f;
+
+    memset(&ns, 0, sizeof(ns));
+    f = fopen(path, "r");
+    if (f == NULL && errno != ENOENT) {
+        fprintf(stderr, "Can't open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    while (f != NULL && fgets(line, sizeof(line), f) != NULL) {
+        ++n;
+        if ((p = strchr(line, '#')) != NULL)
+            *p = '\0';
+        for (i = 0, p = line; i < 6; ++i, p = NULL)
+            if ((tok[i] = strtok_r(p, " \t\r\n", &save)) == NULL)
+                break;
+        if (i == 0)
+            continue;
+        p = strtok_r(NULL, "\r\n", &save);
+        while (p != NULL && isspace(*p))
+            ++p;
+        if (i < 6 || p == NULL || *p == '\0') {
+            fprintf(stderr, "%s:%d: expected MINUTE HOUR DAY MONTH WEEKDAY "
+                    "PORT MESSAGE\n", path, n);
+            goto fail;
+        }
+        if (ns.nrules == CALRULES) {
+            fprintf(stderr, "%s:%d: more than %d rules\n", path, n,
+                    CALRULES);
+            goto fail;
+        }
+
+        r = &ns.rule[ns.nrules];
+        r->anyday = *tok[2] == '*';
+        r->anywday = *tok[4] == '*';
+        for (i = 0; i < 5; ++i)
+            if (cal_field(tok[i], i, &m[i]) < 0) {
+                fprintf(stderr, "%s:%d: bad %s field\n", path, n,
+                        fields[i].name);
+                goto fail;
+            }
+        r->min = m[0];
+        r->hour = m[1];
+        r->day = m[2];
+        r->month = m[3];
+        r->wday = (m[4] | m[4] >> 7) & 0x7f;
+        snprintf(r->port, sizeof(r->port), "%s", tok[5]);
+        snprintf(r->msg, sizeof(r->msg), "%s", p);
+
+        if ((at = cal_after(r, now)) < 0) {
+            fprintf(stderr, "%s:%d: never fires\n", path, n);
+            goto fail;
+        }
+        cal_push(&ns, at, ns.nrules++);
+    }
+    if (f != NULL)
+        fclose(f);
+    *s = ns;
+    return s->nrules;
+
+fail:
+    fclose(f);
+    return -1;
+}
+
+/*
+ * Take a rule that is due at now and schedule it again. Returns the rule
+ * or -1 if none is due. A rule that fell due more than once since the
+ * last call fires once.
+ */
+int cal_pop(struct calendar *s, time_t now)
+{
+    int rule;
+
+    if (s->n == 0 || s->heap[0].at > now)
+        return -1;
+    rule = s->heap[0].rule;
+    if ((s->heap[0].at = cal_after(&s->rule[rule], now)) < 0)
+        s->heap[0] = s->heap[--s->n];
+    cal_down(s, 0);
+    return rule;
+}
+
+/* Time in ms to the next rule, negative if there is none */
+double cal_due(struct calendar *s, double now)
+{
+    double at;
+
+    if (s->n == 0)
+        return -1;
+    at = s->heap[0].at * 1000.0;
+    return at > now ? at - now : 0;
+}
@@ -0,0 +1,80 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Announcement scheduler
+ *
+ * Announcements are given by cron like rules, one per line:
+ *
+ *      MINUTE HOUR DAY MONTH WEEKDAY PORT MESSAGE
+ *
+ * The time fields take *, numbers, ranges and lists with an optional
+ * /STEP, weekday 0 or 7 is Sunday. As with cron, when both the day and
+ * the weekday are restricted either one matching will do. PORT is the
+ * name of a port or * for all of them, MESSAGE is handed to the announce
+ * script. '#' starts a comment.
+ *
+ * Each rule is compiled into bit masks, and the next time each one fires
+ * is kept in a min-heap so only the earliest has to be looked at.
+ */
+
+#include <time.h>
+#include <stdint.h>
+
+#define CALFILE     "/etc/repeater.sched"
+#define CALRULES    64
+#define CALMSG      64
+
+struct calrule {
+    uint64_t    min;            /* Bit masks of the matching values */
+    uint32_t    hour;
+    uint32_t    day;            /* Days 1-31 */
+    uint16_t    month;          /* Months 1-12 */
+    uint8_t     wday;           /* Weekdays 0-6 */
+    uint8_t     anyday;         /* Day or weekday given as * */
+    uint8_t     anywday;
+    char        port[16];
+    char        msg[CALMSG];
+};
+
+struct calent {
+    time_t      at;             /* Next time the rule fires */
+    int         rule;
+};
+
+struct calendar {
+    int         nrules;
+    struct calrule rule[CALRULES];
+    int         n;              /* Entries in the heap */
+    struct calent heap[CALRULES];
+};
+
+int  cal_load(struct calendar *s, const char *path, time_t now);
+int  cal_pop(struct calendar *s, time_t now);
+double cal_due(struct calendar *s, double now);
@@ -0,0 +1,208 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include "config.h"
+
+/* What we know about each setting */
+static struct confvar {
+    char    *name;
+    size_t  off;                /* Offset in struct rptconf */
+    int     min;                /* Valid range */
+    int     max;
+    int     def;
+} confvars[] = {
+    { "HANGTIME", offsetof(struct rptconf, hangtime), 0, 60000, HANGTIME },
+    { "SHORTKEY", offsetof(struct rptconf, shortkey), 0, 10000, SHORTKEY },
+    { "FANDELAY", offsetof(struct rptconf, fandelay), 0, 3600000, FANDELAY },
+    { "MUTETIME", offsetof(struct rptconf, mutetime), 0, 60000, MUTETIME },
+    { "CTTIME",   offsetof(struct rptconf, cttime),   0, 60000, CTTIME },
+    { "CTTIMEI",  offsetof(struct rptconf, cttimei),  0, 60000, CTTIMEI },
+    { "IDPERIOD", offsetof(struct rptconf, idperiod), 1000, 3600000, IDPERIOD },
+    { "IDWAIT",   offsetof(struct rptconf, idwait),   0, 3600000, IDWAIT },
+    { "IDKEYDLY", offsetof(struct rptconf, idkeydly), 0, 5000, IDKEYDLY },
+    { "STALLTIME", offsetof(struct rptconf, stalltime), 20, 60000, STALLTIME },
+    { "FASTPOLL", offsetof(struct rptconf, fastpoll), 1, 100, FASTPOLL },
+    { "IDLEPOLL", offsetof(struct rptconf, idlepoll), 1, 1000, IDLEPOLL },
+    { "POLLDECAY", offsetof(struct rptconf, polldecay), 0, 60000, POLLDECAY },
+    { NULL,       0,                                  0, 0, 0 }
+};
+
+#define CONFVAR(c, v)   (*(int *)((char *)(c) + (v)->off))
+
+void conf_defaults(struct rptconf *c)
+{
+    struct confvar *v;
+
+    for (v = confvars; v->name != NULL; ++v)
+        CONFVAR(c, v) = v->def;
+}
+
+/*
+ * Read a configuration file into c. On any error c is left alone and -1
+ * returned, the reason goes to stderr.
+ */
+int conf_load(const char *path, struct rptconf *c)
+{
+    struct rptconf nc;
+    struct confvar *v;
+    char line[256], *name, *val, *end, *p;
+    long l;
+    int n = 0;
+    FILE *f;
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "Can't open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    conf_defaults(&nc);
+    while (fgets(line, sizeof(line), f) != NULL) {
+        ++n;
+        if ((p = strchr(line, '#')) != NULL)
+            *p = '\0';
+        for (name = line; isspace(*name); ++name)
+            ;
+        if (*name == '\0')
+            continue;
+
+        val = strchr(name, '=');
+        if (val == NULL) {
+            fprintf(stderr, "%s:%d: expected NAME = VALUE\n", path, n);
+            goto fail;
+        }
+        for (p = val++; p > name && isspace(p[-1]); --p)
+            ;
+        *p = '\0';
+
+        for (v = confvars; v->name != NULL; ++v)
+            if (!strcasecmp(name, v->name))
+                break;
+        if (v->name == NULL) {
+            fprintf(stderr, "%s:%d: unknown setting %s\n", path, n, name);
+            goto fail;
+        }
+
+        errno = 0;
+        l = strtol(val, &end, 10);
+        while (isspace(*end))
+            ++end;
+        if (errno || end == val || *end != '\0' || l < v->min || l > v->max) {
+            fprintf(stderr, "%s:%d: %s must be %d to %d\n", path, n,
+                    v->name, v->min, v->max);
+            goto fail;
+        }
+        CONFVAR(&nc, v) = l;
+    }
+    fclose(f);
+    *c = nc;
+    return 0;
+
+fail:
+    fclose(f);
+    return -1;
+}
+
+/*
+ * Describe setting i if it differs between a and b. Returns -1 past the
+ * last setting, 1 if buf holds a description and 0 otherwise.
+ */
+int conf_diff(struct rptconf *a, struct rptconf *b, int i, char *buf, int n)
+{
+    struct confvar *v = &confvars[i];
+
+    if (v->name == NULL)
+        return -1;
+    if (CONFVAR(a, v) == CONFVAR(b, v))
+        return 0;
+    snprintf(buf, n, "Config: %s %d -> %d", v->name, CONFVAR(a, v),
+             CONFVAR(b, v));
+    return 1;
+}
+
+/*
+ * Watch the directory of the file, editors tend to replace a file rather
+ * than write to it.
+ */
+int conf_watch(const char *path)
+{
+    char dir[256], *p;
+    int fd;
+
+    snprintf(dir, sizeof(dir), "%s", path);
+    p = strrchr(dir, '/');
+    if (p == NULL)
+        snprintf(dir, sizeof(dir), ".");
+    else if (p == dir)
+        p[1] = '\0';
+    else
+        *p = '\0';
+
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    if (inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Drain pending events, returns 1 if any of them was about our file
+ */
+int conf_changed(int fd, const char *path)
+{
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    struct inotify_event *ev;
+    const char *base;
+    ssize_t n;
+    char *p;
+    int hit = 0;
+
+    base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        for (p = buf; p < buf + n; p += sizeof(*ev) + ev->len) {
+            ev = (struct inotify_event *)p;
+            if (ev->len && !strcmp(ev->name, base))
+                hit = 1;
+        }
+    }
+    return hit;
+}
@@ -0,0 +1,77 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Runtime configuration
+ *
+ * The timing values are read from a file of NAME = VALUE lines, values
+ * in milliseconds, '#' starts a comment. Names not in the file keep
+ * their default. A file that does not parse or holds a value out of
+ * range is rejected as a whole and the running configuration stays.
+ */
+
+#define CONFFILE    "/etc/repeater.conf"
+
+/* Default timing values */
+/* NOTE: all times are in millseconds */
+#define HANGTIME    3000
+#define SHORTKEY    10
+#define FANDELAY    300000
+#define MUTETIME    1000
+#define CTTIME      1000
+#define CTTIMEI     300
+#define IDPERIOD    1200000
+#define IDWAIT      480000
+#define IDKEYDLY    100
+#define STALLTIME   500
+#define FASTPOLL    1
+#define IDLEPOLL    20
+#define POLLDECAY   1000
+
+struct rptconf {
+    int     hangtime;
+    int     shortkey;
+    int     fandelay;
+    int     mutetime;
+    int     cttime;
+    int     cttimei;
+    int     idperiod;
+    int     idwait;
+    int     idkeydly;
+    int     stalltime;
+    int     fastpoll;
+    int     idlepoll;
+    int     polldecay;
+};
+
+void conf_defaults(struct rptconf *c);
+int conf_load(const char *path, struct rptconf *c);
+int conf_diff(struct rptconf *a, struct rptconf *b, int i, char *buf, int n);
+int conf_watch(const char *path);
+int conf_changed(int fd, const char *path);
@@ -0,0 +1,301 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/time.h>
+#include "control.h"
+
+/*
+ * Bind the controller end. A socket left behind by a previous controller
+ * is replaced, the caller makes sure only one controller runs.
+ */
+int ctl_open(const char *path)
+{
+    struct sockaddr_un sa;
+    int fd;
+
+    fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Can't create control socket: %s\n", strerror(errno));
+        return -1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        fprintf(stderr, "Can't bind %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Take the next request if there is one. Returns 1 with a nul terminated
+ * request, 0 when none is waiting.
+ */
+int ctl_recv(int fd, struct ctlmsg *m)
+{
+    ssize_t n;
+
+    m->fromlen = sizeof(m->from);
+    n = recvfrom(fd, m->buf, sizeof(m->buf) - 1, 0,
+                 (struct sockaddr *)&m->from, &m->fromlen);
+    if (n < 0)
+        return 0;
+    m->buf[n] = '\0';
+    return 1;
+}
+
+/*
+ * Answer a request, a client that went away is not our problem
+ */
+int ctl_reply(int fd, struct ctlmsg *m, const char *txt)
+{
+    if (m->fromlen <= sizeof(sa_family_t))
+        return -1;
+    return sendto(fd, txt, strlen(txt), MSG_DONTWAIT,
+                  (struct sockaddr *)&m->from, m->fromlen);
+}
+
+void ctl_close(int fd, const char *path)
+{
+    if (fd < 0)
+        return;
+    close(fd);
+    unlink(path);
+}
+
+/*
+ * Client side, send a request and wait for the reply. Returns -1 with
+ * errno set when no controller listens on path.
+ */
+int ctl_request(const char *path, const char *req, char *reply, int n)
+{
+    struct sockaddr_un sa;
+    struct timeval tv;
+    ssize_t k;
+    int fd, e;
+
+    fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    /* Autobind so the controller has an address to answer to */
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa_family_t)) < 0)
+        goto fail;
+
+    snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", path);
+    if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+        goto fail;
+
+    tv.tv_sec = CTLWAIT / 1000;
+    tv.tv_usec = (CTLWAIT % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    if (send(fd, req, strlen(req), 0) < 0)
+        goto fail;
+    k = recv(fd, reply, n - 1, 0);
+    if (k < 0)
+        goto fail;
+    reply[k] = '\0';
+    close(fd);
+    return k;
+
+fail:
+    e = errno;
+    close(fd);
+    errno = e;
+    return -1;
+}
+
+/*
+ * Answer a handoff request with the state and the descriptors that go
+ * with it
+ */
+int ctl_handoff(int fd, struct ctlmsg *m, void *data, int len, int *fds,
+                int nfds)
+{
+    char cbuf[CMSG_SPACE(sizeof(int) * CTLFDS)];
+    struct msghdr msg;
+    struct cmsghdr *cm;
+    struct iovec iov;
+
+    if (nfds > CTLFDS || m->fromlen <= sizeof(sa_family_t))
+        return -1;
+    memset(&msg, 0, sizeof(msg));
+    memset(cbuf, 0, sizeof(cbuf));
+    iov.iov_base = data;
+    iov.iov_len = len;
+    msg.msg_name = &m->from;
+    msg.msg_namelen = m->fromlen;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+    cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+    memcpy(CMSG_DATA(cm), fds, sizeof(int) * nfds);
+    return sendmsg(fd, &msg, 0) == len ? 0 : -1;
+}
+
+/*
+ * Wait for the taker of a handoff to confirm, for at most CTLWAIT. Other
+ * requests meanwhile are refused and idle is called every 10 ms. Returns
+ * 0 once the taker was told to go ahead, -1 if it stayed quiet.
+ */
+int ctl_handed(int fd, struct ctlmsg *m, void (*idle)())
+{
+    struct ctlmsg a;
+    struct pollfd pfd;
+    int ms;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    for (ms = 0; ms < CTLWAIT; ms += 10) {
+        while (ctl_recv(fd, &a)) {
+            if (a.fromlen == m->fromlen &&
+                    !memcmp(&a.from, &m->from, m->fromlen) &&
+                    !strcmp(a.buf, CTLTAKEN)) {
+                ctl_reply(fd, &a, CTLDONE);
+                return 0;
+            }
+            ctl_reply(fd, &a, "error handoff in progress");
+        }
+        if (idle != NULL)
+            idle();
+        poll(&pfd, 1, 10);
+    }
+    return -1;
+}
+
+/*
+ * Ask the running controller to hand over. Returns the descriptors
+ * received, the state is in data. A refusal fails with EBUSY while the
+ * controller plays a script and is worth another try, any other refusal
+ * is printed and fails with EPROTO. No controller to take over from fails
+ * with ENOENT or ECONNREFUSED.
+ *
+ * Having the state we confirm and wait for the go ahead. If the old
+ * controller gave up on us and carries on, it answers with an error and
+ * we close the descriptors again. Without an answer it is gone and the
+ * ports are ours.
+ */
+int ctl_takeover(const char *path, const char *req, void *data, int len,
+                 int *fds, int maxfds)
+{
+    char cbuf[CMSG_SPACE(sizeof(int) * CTLFDS)];
+    struct sockaddr_un sa;
+    struct timeval tv;
+    struct msghdr msg;
+    struct cmsghdr *cm;
+    struct iovec iov;
+    ssize_t k;
+    int fd, n = 0, e;
+
+    fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa_family_t)) < 0)
+        goto fail;
+    snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", path);
+    if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+        goto fail;
+    tv.tv_sec = CTLWAIT / 1000;
+    tv.tv_usec = (CTLWAIT % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (send(fd, req, strlen(req), 0) < 0)
+        goto fail;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = data;
+    iov.iov_len = len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    k = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    if (k < 0)
+        goto fail;
+    for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS)
+            continue;
+        n = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        if (n > maxfds)
+            n = maxfds;
+        memcpy(fds, CMSG_DATA(cm), sizeof(int) * n);
+    }
+    if (k == len && n) {
+        k = -1;
+        if (send(fd, CTLTAKEN, strlen(CTLTAKEN), 0) >= 0)
+            k = recv(fd, cbuf, sizeof(cbuf) - 1, 0);
+        if (k >= 0)
+            cbuf[k] = '\0';
+        close(fd);
+        if (k < 0 || !strcmp(cbuf, CTLDONE))
+            return n;
+        fprintf(stderr, "Handoff given up by the running controller\n");
+        while (n > 0)
+            close(fds[--n]);
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    /* Refused, the answer is text */
+    ((char *)data)[k < len ? k : len - 1] = '\0';
+    while (n > 0)
+        close(fds[--n]);
+    close(fd);
+    if (!strncmp(data, "error busy", 10)) {
+        errno = EBUSY;
+        return -1;
+    }
+    fprintf(stderr, "Handoff refused: %s\n", (char *)data);
+    errno = EPROTO;
+    return -1;
+
+fail:
+    e = errno;
+    close(fd);
+    errno = e;
+    return -1;
+}
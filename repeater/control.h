@@ -0,0 +1,74 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Control socket
+ *
+ * A running controller listens on a UNIX datagram socket. Each datagram
+ * names a port followed by one or more commands, e.g.
+ *
+ *   parport0 key mute
+ *
+ * The controller applies them through its own state and answers with
+ * the resulting state of the port, or a line starting with "error".
+ *
+ * A new controller taking over from a running one asks for a handoff and
+ * receives a snapshot of the state with the open descriptors attached.
+ * It confirms with CTLTAKEN. Until then the old controller keeps the
+ * ports, and it carries on with them if no confirmation comes within
+ * CTLWAIT.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define CTLSOCK     "/tmp/repeater-ctl"
+#define CTLMSG      256         /* Max length of a request or reply */
+#define CTLWAIT     1000        /* Client wait for the reply in ms */
+#define CTLFDS      8           /* Descriptors passed with a handoff */
+#define CTLTAKEN    "handoff taken"
+#define CTLDONE     "handoff done"
+
+struct ctlmsg {
+    struct sockaddr_un  from;   /* Who to reply to */
+    socklen_t           fromlen;
+    char                buf[CTLMSG];
+};
+
+int ctl_open(const char *path);
+int ctl_recv(int fd, struct ctlmsg *m);
+int ctl_reply(int fd, struct ctlmsg *m, const char *txt);
+void ctl_close(int fd, const char *path);
+int ctl_request(const char *path, const char *req, char *reply, int n);
+int ctl_handoff(int fd, struct ctlmsg *m, void *data, int len, int *fds,
+                int nfds);
+int ctl_handed(int fd, struct ctlmsg *m, void (*idle)());
+int ctl_takeover(const char *path, const char *req, void *data, int len,
+                 int *fds, int maxfds);
@@ -0,0 +1,150 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "filter.h"
+
+/*
+ * A line filter from its setting: none, maj or int:K
+ */
+int filter_parse(struct linefilter *f, const char *val)
+{
+    char *end;
+    long k;
+
+    if (!strcmp(val, "none")) {
+        f->type = FILTER_NONE;
+        return 0;
+    }
+    if (!strcmp(val, "maj")) {
+        f->type = FILTER_MAJORITY;
+        return 0;
+    }
+    if (!strncmp(val, "int:", 4)) {
+        k = strtol(val + 4, &end, 0);
+        if (end == val + 4 || *end != '\0' || k < 1 || k > BURSTMAX)
+            return -1;
+        f->type = FILTER_INTEGRATE;
+        f->count = k;
+        return 0;
+    }
+    return -1;
+}
+
+/* Is any line filtered */
+int filter_active(struct portfilter *pf)
+{
+    int i;
+
+    for (i = 0; i < FILTERLINES; ++i)
+        if (pf->line[i].type != FILTER_NONE)
+            return 1;
+    return 0;
+}
+
+/* The clean value of one bit over a burst, old unless the burst decides */
+static int filter_bit(struct linefilter *f, int ones, int n, int old)
+{
+    int k;
+
+    switch (f->type) {
+    case FILTER_MAJORITY:
+        if (2 * ones != n)
+            return 2 * ones > n;
+        return old;
+    case FILTER_INTEGRATE:
+        k = f->count < n ? f->count : n;
+        if (ones >= k && n - ones < k)
+            return 1;
+        if (n - ones >= k && ones < k)
+            return 0;
+        return old;
+    }
+    return -1;
+}
+
+/*
+ * Condition a burst of n status samples taken from start to end (us) into
+ * a clean status register. masks holds the status bits of each line. The
+ * time of the earliest clean edge goes to edgeus, it is left alone if
+ * there was none.
+ */
+unsigned char filter_run(struct portfilter *pf, unsigned char *masks,
+                         unsigned char *status, int n, uint64_t start,
+                         uint64_t end, uint64_t *edgeus)
+{
+    struct linefilter *f;
+    unsigned char clean = status[n - 1], bit;
+    uint64_t at, first = 0;
+    int i, l, b, ones, v, old, edge, odd;
+
+    if (!pf->primed) {
+        pf->state = clean;
+        pf->primed = 1;
+    }
+
+    for (l = 0; l < FILTERLINES; ++l) {
+        f = &pf->line[l];
+        if (f->type == FILTER_NONE)
+            continue;
+        edge = odd = 0;
+        for (b = 0; b < 8; ++b) {
+            bit = 1 << b;
+            if (!(masks[l] & bit))
+                continue;
+            for (i = ones = 0; i < n; ++i)
+                ones += !!(status[i] & bit);
+            old = !!(pf->state & bit);
+            v = filter_bit(f, ones, n, old);
+            clean = v ? clean | bit : clean & ~bit;
+
+            /* Date the edge at the first sample showing the new value */
+            if (v != old) {
+                edge = 1;
+                for (i = 0; i < n && !!(status[i] & bit) != v; ++i)
+                    ;
+                at = n > 1 ? start + (end - start) * i / (n - 1) : end;
+                if (!first || at < first)
+                    first = at;
+            } else if (ones != (v ? n : 0)) {
+                odd = 1;
+            }
+        }
+        if (edge)
+            f->edges++;
+        else if (odd)
+            f->glitches++;
+    }
+
+    pf->state = clean;
+    if (first)
+        *edgeus = first;
+    return clean;
+}
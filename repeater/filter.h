@@ -0,0 +1,77 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Input conditioning
+ *
+ * A noisy COS or DTMF line is read several times in a row every pass, a
+ * burst, and judged on the whole burst rather than on a single sample.
+ * With majority a line takes the value most samples show. With integrate
+ * the samples are summed and a line only changes once at least K of them
+ * show the new value, a burst in between keeps the old one. A burst that
+ * showed something the line does not end up with is counted as a glitch.
+ *
+ * A clean edge is dated at the first sample of the burst that showed the
+ * new value, so the controller sees when the line changed rather than
+ * when the pass noticed.
+ */
+
+#include <stdint.h>
+
+#define FILTER_NONE     0       /* The last sample of the burst */
+#define FILTER_MAJORITY 1
+#define FILTER_INTEGRATE 2
+
+#define BURSTMAX        16      /* Status reads per pass, at most */
+#define BURSTDEF        5       /* and once a line is filtered */
+
+/* Conditioned lines */
+#define LINE_COS        0
+#define LINE_DTMF       1       /* Q1-Q4, each bit on its own */
+#define FILTERLINES     2
+
+struct linefilter {
+    int         type;
+    int         count;          /* Samples to change, integrate only */
+    uint64_t    edges;          /* Clean edges */
+    uint64_t    glitches;       /* Bursts rejected */
+};
+
+struct portfilter {
+    int         burst;          /* Status reads per pass, 0 for default */
+    int         primed;         /* A clean state is known */
+    unsigned char state;        /* Clean status register */
+    struct linefilter line[FILTERLINES];
+};
+
+int filter_parse(struct linefilter *f, const char *val);
+int filter_active(struct portfilter *pf);
+unsigned char filter_run(struct portfilter *pf, unsigned char *masks,
+                         unsigned char *status, int n, uint64_t start,
+                         uint64_t end, uint64_t *edgeus);
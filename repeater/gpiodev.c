@@ -0,0 +1,228 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * GPIO backend
+ *
+ * Boards wired to a GPIO header instead of a parallel port are driven
+ * through the GPIO character device, v2 uAPI. Every register bit of the
+ * parallel port can be given a line, see struct gpiomap, so the rest of
+ * the controller keeps working with status and data bytes and pin masks.
+ *
+ * All lines are taken with one request. Inputs are requested with edge
+ * detection on both edges and realtime kernel timestamps, the request fd
+ * becomes readable on an edge so the controller can sleep on it. A write
+ * sets only the lines it changes and leaves the others to whoever else
+ * shares the request, there is no read-modify-write to race with.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+#include "irlpdev.h"
+
+/* Is register bit b an output */
+static int gpio_isout(struct irlpdev *d, int b)
+{
+    return b >= 8 && !(d->map.datain & (1 << (b - 8)));
+}
+
+static void gpio_attr(struct gpio_v2_line_config *c, uint64_t flags,
+                      uint64_t mask)
+{
+    if (!mask)
+        return;
+    c->attrs[c->num_attrs].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+    c->attrs[c->num_attrs].attr.flags = flags;
+    c->attrs[c->num_attrs].mask = mask;
+    c->num_attrs++;
+}
+
+/*
+ * Number the mapped lines in register bit order, which lines are outputs
+ * and which active low
+ */
+static int gpio_map(struct irlpdev *d, uint32_t *offsets, uint64_t *outs,
+                    uint64_t *lows)
+{
+    int b, n = 0;
+
+    *outs = *lows = 0;
+    for (b = 0; b < GPIOBITS; ++b) {
+        if (d->map.line[b] < 0)
+            continue;
+        offsets[n] = d->map.line[b];
+        d->bit[n] = b;
+        if (gpio_isout(d, b))
+            *outs |= 1ULL << n;
+        if (d->map.low & (1 << b))
+            *lows |= 1ULL << n;
+        ++n;
+    }
+    d->nlines = n;
+    return n;
+}
+
+/*
+ * Take over the lines another controller requested with the same map
+ */
+int gpio_adopt(struct irlpdev *d, int fd)
+{
+    uint32_t offsets[GPIOBITS];
+    uint64_t outs, lows;
+
+    gpio_map(d, offsets, &outs, &lows);
+    d->fd = fd;
+    return fd;
+}
+
+/*
+ * Request the mapped lines, outputs start as the data bits of seed
+ */
+int gpio_open(struct irlpdev *d)
+{
+    struct gpio_v2_line_request req;
+    uint64_t outs, lows, in, vals;
+    int chip, i;
+
+    memset(&req, 0, sizeof(req));
+    req.num_lines = gpio_map(d, req.offsets, &outs, &lows);
+    snprintf(req.consumer, sizeof(req.consumer), "repeater");
+
+    /* First matching attribute wins, the default is an input */
+    in = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING |
+         GPIO_V2_LINE_FLAG_EDGE_FALLING |
+         GPIO_V2_LINE_FLAG_EVENT_CLOCK_REALTIME;
+    req.config.flags = in;
+    gpio_attr(&req.config, GPIO_V2_LINE_FLAG_OUTPUT |
+              GPIO_V2_LINE_FLAG_ACTIVE_LOW, outs & lows);
+    gpio_attr(&req.config, in | GPIO_V2_LINE_FLAG_ACTIVE_LOW, ~outs & lows);
+    gpio_attr(&req.config, GPIO_V2_LINE_FLAG_OUTPUT, outs);
+    if (outs) {
+        vals = 0;
+        for (i = 0; i < d->nlines; ++i)
+            if ((outs & (1ULL << i)) && (d->seed & (1 << (d->bit[i] - 8))))
+                vals |= 1ULL << i;
+        req.config.attrs[req.config.num_attrs].attr.id =
+            GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+        req.config.attrs[req.config.num_attrs].attr.values = vals;
+        req.config.attrs[req.config.num_attrs].mask = outs;
+        req.config.num_attrs++;
+    }
+
+    chip = open(d->path, O_RDWR | O_CLOEXEC);
+    if (chip < 0) {
+        irlpdev_error(d, "open");
+        return -1;
+    }
+    if (ioctl(chip, GPIO_V2_GET_LINE_IOCTL, &req) < 0) {
+        irlpdev_error(d, "GPIO_V2_GET_LINE_IOCTL");
+        close(chip);
+        return -1;
+    }
+    close(chip);
+
+    /* Edge events are drained on every read, never wait for them */
+    fcntl(req.fd, F_SETFL, fcntl(req.fd, F_GETFL) | O_NONBLOCK);
+    d->fd = req.fd;
+    return d->fd;
+}
+
+/*
+ * Read the lines into status and data bytes. Pending edge events are
+ * consumed, the latest one tells when the inputs last changed. A second
+ * handle shares the line request and leaves the events to the first.
+ */
+int gpio_read(struct irlpdev *d, unsigned char *buff)
+{
+    struct gpio_v2_line_event ev[16];
+    ssize_t k;
+    int i;
+
+    while (!d->dup && (k = read(d->fd, ev, sizeof(ev))) > 0)
+        for (i = 0; i < k / (int)sizeof(ev[0]); ++i)
+            d->edgeus = ev[i].timestamp_ns / 1000;
+    return gpio_values(d, buff);
+}
+
+/*
+ * Read the lines only, for writes that need the current outputs
+ */
+int gpio_values(struct irlpdev *d, unsigned char *buff)
+{
+    struct gpio_v2_line_values v;
+    int i, b;
+
+    v.mask = (d->nlines < 64 ? 1ULL << d->nlines : 0) - 1;
+    v.bits = 0;
+    if (ioctl(d->fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &v) < 0) {
+        irlpdev_error(d, "GPIO_V2_LINE_GET_VALUES_IOCTL");
+        return -1;
+    }
+
+    buff[0] = 0;
+    buff[1] = 0;
+    for (i = 0; i < d->nlines; ++i) {
+        if (!(v.bits & (1ULL << i)))
+            continue;
+        b = d->bit[i];
+        buff[b / 8] |= 1 << (b % 8);
+    }
+    return 2;
+}
+
+/*
+ * Raise the output lines of the data bits in set and lower those in clr,
+ * in one go. The other lines are not touched.
+ */
+int gpio_write(struct irlpdev *d, unsigned char set, unsigned char clr)
+{
+    struct gpio_v2_line_values v;
+    int i, b;
+
+    v.mask = 0;
+    v.bits = 0;
+    for (i = 0; i < d->nlines; ++i) {
+        b = d->bit[i];
+        if (!gpio_isout(d, b) || !((set | clr) & (1 << (b - 8))))
+            continue;
+        v.mask |= 1ULL << i;
+        if (set & (1 << (b - 8)))
+            v.bits |= 1ULL << i;
+    }
+    if (v.mask && ioctl(d->fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &v) < 0) {
+        irlpdev_error(d, "GPIO_V2_LINE_SET_VALUES_IOCTL");
+        return -1;
+    }
+    return 1;
+}
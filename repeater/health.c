@@ -0,0 +1,139 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "irlpdev.h"
+#include "stats.h"
+#include "log.h"
+#include "health.h"
+
+void health_init(struct health *h, struct portstats *st)
+{
+    memset(h, 0, sizeof(*h));
+    h->logat = -HEALTHLOG;
+    h->st = st;
+    st->downsince = 0;          /* Whatever a restored state says */
+}
+
+/*
+ * A read or write failed. The first error is reported at once, those
+ * that follow within HEALTHLOG as a count. Returns 1 when this failure
+ * takes the port down, after that every failure is a reopen that failed
+ * and pushes the next one out.
+ */
+int health_fail(struct health *h, double now, const char *name,
+                struct irlpdev *d)
+{
+    char buf[LOGTXT];
+
+    h->st->porterrors++;
+    h->errors++;
+    h->fails++;
+    if (now - h->logat >= HEALTHLOG) {
+        if (h->errors == 1)
+            snprintf(buf, sizeof(buf), "%s: %s %s: %s", name, d->errop,
+                     d->path, strerror(d->err));
+        else
+            snprintf(buf, sizeof(buf), "%s: %d more errors, last %s: %s",
+                     name, h->errors, d->errop, strerror(d->err));
+        do_log(buf);
+        h->errors = 0;
+        h->logat = now;
+    }
+
+    if (h->down) {
+        h->backoff *= 2;
+        if (h->backoff > BACKOFFMAX)
+            h->backoff = BACKOFFMAX;
+        h->retryat = now + h->backoff;
+        return 0;
+    }
+    if (h->fails < HEALTHFAILS)
+        return 0;
+
+    h->down = 1;
+    h->downat = now;
+    h->backoff = BACKOFFMIN;
+    h->retryat = now + h->backoff;
+    h->st->outages++;
+    h->st->downsince = now;
+    snprintf(buf, sizeof(buf), "%s: Out of service, outputs safe", name);
+    do_log(buf);
+    return 1;
+}
+
+/*
+ * A read went through. Returns 1 when this puts the port back in service.
+ */
+int health_ok(struct health *h, double now, const char *name)
+{
+    char buf[LOGTXT];
+    uint64_t us;
+
+    h->fails = 0;
+    if (!h->down) {
+        if (h->errors && now - h->logat >= HEALTHLOG) {
+            snprintf(buf, sizeof(buf), "%s: %d more errors", name, h->errors);
+            do_log(buf);
+            h->errors = 0;
+            h->logat = now;
+        }
+        return 0;
+    }
+
+    h->down = 0;
+    us = (now - h->downat) * 1000;
+    h->st->downus += us;
+    if (us > h->st->maxdownus)
+        h->st->maxdownus = us;
+    h->st->recoveries++;
+    h->st->downsince = 0;
+    snprintf(buf, sizeof(buf), "%s: Back in service after %.1f s, %d errors",
+             name, us / 1e6, h->errors);
+    do_log(buf);
+    h->errors = 0;
+    h->logat = now;
+    return 1;
+}
+
+/* Time to try opening a port that is down */
+int health_retry(struct health *h, double now)
+{
+    return h->down && now >= h->retryat;
+}
+
+/* Time to the next reopen, negative if the port is in service */
+double health_due(struct health *h, double now)
+{
+    if (!h->down)
+        return -1;
+    return now < h->retryat ? h->retryat - now : 0;
+}
@@ -0,0 +1,64 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Port health
+ *
+ * A port that fails to read or write is taken out of service after a few
+ * failures in a row, with its outputs left safe. It is then reopened
+ * after a backoff that doubles with every failed try, up to a limit, and
+ * put back in service once it reads again. Errors are not reported one by
+ * one but counted and reported at most every so often.
+ */
+
+struct portstats;               /* See stats.h */
+struct irlpdev;                 /* See irlpdev.h */
+
+#define HEALTHFAILS 3           /* Failures in a row that take a port down */
+#define HEALTHLOG   10000       /* ms between reports of errors */
+#define BACKOFFMIN  100         /* ms to the first reopen */
+#define BACKOFFMAX  30000       /* and the most between two */
+
+struct health {
+    int     down;               /* Out of service */
+    int     fails;              /* Failures in a row */
+    int     errors;             /* Not reported yet */
+    double  logat;              /* Last report */
+    double  downat;             /* Start of the outage */
+    double  retryat;            /* Next reopen */
+    double  backoff;            /* Wait before the reopen after that */
+    struct portstats *st;
+};
+
+void health_init(struct health *h, struct portstats *st);
+int  health_fail(struct health *h, double now, const char *name,
+                 struct irlpdev *d);
+int  health_ok(struct health *h, double now, const char *name);
+int  health_retry(struct health *h, double now);
+double health_due(struct health *h, double now);
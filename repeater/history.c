@@ -0,0 +1,182 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "history.h"
+
+static struct histhdr *hist = NULL;
+
+/* Lay out the tiers, each its bucket numbers and then its metrics */
+static uint64_t hist_layout(struct histhdr *h)
+{
+    static const uint32_t steps[HISTTIERS] = { 60, 3600, 86400 };
+    static const uint32_t slots[HISTTIERS] =
+        { HISTMINUTES, HISTHOURS, HISTDAYS };
+    uint64_t off = sizeof(struct histhdr);
+    int t;
+
+    for (t = 0; t < HISTTIERS; ++t) {
+        h->tier[t].step = steps[t];
+        h->tier[t].slots = slots[t];
+        h->tier[t].off = off;
+        off += (uint64_t)slots[t] * sizeof(uint32_t) *
+               (1 + HISTPORTS * HISTMETRICS);
+    }
+    return off;
+}
+
+uint32_t *hist_stamps(struct histhdr *h, int tier)
+{
+    return (uint32_t *)((char *)h + h->tier[tier].off);
+}
+
+uint32_t *hist_column(struct histhdr *h, int tier, int port, int metric)
+{
+    return hist_stamps(h, tier) +
+           (uint64_t)h->tier[tier].slots * (1 + port * HISTMETRICS + metric);
+}
+
+/*
+ * Map the history for the controller, a file of another layout is
+ * started over
+ */
+int hist_open(char *path)
+{
+    struct histhdr h;
+    uint64_t sz;
+    int fd;
+
+    memset(&h, 0, sizeof(h));
+    sz = hist_layout(&h);
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Can't open history %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, sz) < 0) {
+        fprintf(stderr, "Can't size history %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    hist = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (hist == MAP_FAILED) {
+        fprintf(stderr, "Can't map history %s: %s\n", path, strerror(errno));
+        hist = NULL;
+        return -1;
+    }
+
+    if (hist->magic != HISTMAGIC || hist->version != HISTVERSION ||
+            hist->size != sz || memcmp(hist->tier, h.tier, sizeof(h.tier))) {
+        memset(hist, 0, sz);    /* Bucket number 0 is never current */
+        h.magic = HISTMAGIC;
+        h.version = HISTVERSION;
+        h.size = sz;
+        memcpy(hist, &h, sizeof(h));
+    }
+    return 0;
+}
+
+/* Name a port, the readers select ports by name */
+void hist_port(int port, const char *name)
+{
+    if (hist == NULL || port >= HISTPORTS)
+        return;
+    snprintf(hist->name[port], sizeof(hist->name[port]), "%s", name);
+    if ((uint32_t)port >= hist->nports)
+        hist->nports = port + 1;
+}
+
+/*
+ * Add to the buckets holding time t (seconds since the epoch) of every
+ * tier, starting a bucket whose slot held an older one
+ */
+void hist_add(int port, uint32_t t, uint32_t *v)
+{
+    uint32_t *stamp, b, i;
+    int tier, m, p;
+
+    if (hist == NULL || port >= HISTPORTS)
+        return;
+    for (tier = 0; tier < HISTTIERS; ++tier) {
+        b = t / hist->tier[tier].step;
+        i = b % hist->tier[tier].slots;
+        stamp = hist_stamps(hist, tier);
+        if (stamp[i] != b) {
+            for (p = 0; p < HISTPORTS; ++p)
+                for (m = 0; m < HISTMETRICS; ++m)
+                    hist_column(hist, tier, p, m)[i] = 0;
+            stamp[i] = b;
+        }
+        for (m = 0; m < HISTMETRICS; ++m)
+            hist_column(hist, tier, port, m)[i] += v[m];
+    }
+}
+
+void hist_close()
+{
+    if (hist != NULL)
+        munmap(hist, hist->size);
+    hist = NULL;
+}
+
+/*
+ * Map the history read only for a reader, NULL if there is none
+ */
+struct histhdr *hist_map(char *path)
+{
+    struct histhdr *h, x;
+    struct stat st;
+    int fd;
+
+    memset(&x, 0, sizeof(x));
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) < 0 || (uint64_t)st.st_size != hist_layout(&x)) {
+        close(fd);
+        return NULL;
+    }
+    h = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (h == MAP_FAILED)
+        return NULL;
+    if (h->magic != HISTMAGIC || h->version != HISTVERSION ||
+            memcmp(h->tier, x.tier, sizeof(x.tier))) {
+        munmap(h, st.st_size);
+        return NULL;
+    }
+    return h;
+}
@@ -0,0 +1,92 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Usage history
+ *
+ * A fixed size round robin file mapped into memory keeps the usage of
+ * every port per minute, per hour and per day. The controller adds to
+ * the current bucket of all three tiers as it goes, so the coarser tiers
+ * are the sums of the finer ones and nothing has to be consolidated
+ * later. A bucket is started over when its slot comes around again.
+ *
+ * The layout is columnar: per tier a column with the bucket number held
+ * in each slot, then one column per port and metric. A reader scans only
+ * the columns it asks for.
+ */
+
+#include <stdint.h>
+
+#define HISTFILE    "/var/tmp/repeater.hist"
+#define HISTMAGIC   0x54534948  /* "HIST" */
+#define HISTVERSION 1
+
+/* Tiers */
+#define HIST_MINUTE 0
+#define HIST_HOUR   1
+#define HIST_DAY    2
+#define HISTTIERS   3
+
+/* Slots of each tier: 92 days of minutes, 400 days of hours, 10 years */
+#define HISTMINUTES (92 * 24 * 60)
+#define HISTHOURS   (400 * 24)
+#define HISTDAYS    (10 * 366)
+
+/* Metrics */
+#define HM_TX       0           /* Transmitter keyed, ms */
+#define HM_KEYUPS   1           /* Key ups */
+#define HM_IRLP     2           /* Keyed last by IRLP, ms */
+#define HM_FAN      3           /* Fan on, ms */
+#define HISTMETRICS 4
+
+#define HISTPORTS   4           /* Same as MAXPORTS */
+
+struct histtier {
+    uint32_t    step;           /* Seconds per bucket */
+    uint32_t    slots;
+    uint64_t    off;            /* Of the bucket number column */
+};
+
+struct histhdr {
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    nports;
+    uint32_t    pad;
+    uint64_t    size;           /* Of the whole file */
+    char        name[HISTPORTS][16];
+    struct histtier tier[HISTTIERS];
+};
+
+int  hist_open(char *path);
+void hist_port(int port, const char *name);
+void hist_add(int port, uint32_t t, uint32_t *v);
+void hist_close();
+struct histhdr *hist_map(char *path);
+uint32_t *hist_stamps(struct histhdr *h, int tier);
+uint32_t *hist_column(struct histhdr *h, int tier, int port, int metric);
@@ -10,6 +10,7 @@
     2004-04-06, DL2KCD: Added fallback to legacy device.
     2004-04-17, DL2KCD: Added fcntl() locking to work around Linux kernel bug.
     2013-01-01, VA3ADI: Removed legacy irlp-port
+    2026-10-19, VA3ADI: Per device state to drive several ports at once
 */
 
 /*
@@ -32,8 +33,8 @@
    Why on earth is Linux so much popular than FreeBSD? Sigh... (DL2KCD)
 */
 
-#include "irlpdev.h"
 #include <stdio.h>
+#include <string.h>
 #include <sys/ioctl.h>
 #include <linux/ppdev.h>
 #include <fcntl.h>
@@ -41,106 +42,398 @@
 #include <errno.h>
 #include <sys/file.h>
 #include <stdlib.h>
+#include "irlpdev.h"
+#include "probes.h"
+
+/*
+ * Prepare a device for use. The lockfile is derived from the device name
+ * so /dev/parport0 keeps using the lockfile the IRLP tools know about.
+ */
+void irlpdev_init(struct irlpdev *d, const char *path) {
+    const char *base;
+    int b;
+
+    snprintf(d->path, sizeof(d->path), "%s", path);
+    base = strrchr(d->path, '/');
+    base = base ? base + 1 : d->path;
+    snprintf(d->lockfile, sizeof(d->lockfile), "%s%s", IRLPDEV_LOCK, base);
+    d->fd = -1;
+    d->lockfd = -1;
+    d->shmlock = 0;
+    d->plock = NULL;
+    d->nlines = 0;
+    d->edgeus = 0;
+    d->seed = 0;
+    d->dup = 0;
+    d->quiet = 0;
+    d->err = 0;
+    d->errop = "";
+    memset(&d->map, 0, sizeof(d->map));
+    for (b = 0; b < GPIOBITS; ++b)
+        d->map.line[b] = -1;
+
+    /* Default GPIO wiring: DTMF Q1-Q4 and COS on lines 0-4, the IRLP key
+     * on line 5 and D2-D6 (KEY, MUTE, CTCSS, FAN, AUX5) on lines 6-10
+     */
+    d->gpio = !strncmp(path, IRLPDEV_GPIO, strlen(IRLPDEV_GPIO));
+    if (d->gpio) {
+        for (b = 3; b < 8; ++b)
+            d->map.line[b] = b - 3;
+        d->map.line[8 + 1] = 5;
+        for (b = 2; b < 7; ++b)
+            d->map.line[8 + b] = b + 4;
+    }
+}
+
+/*
+ * Wire a register bit, s0-s7 or d0-d7, to a GPIO line. The line is its
+ * offset, prefixed with ! if active low, or - to leave the bit unwired.
+ */
+int irlpdev_line(struct irlpdev *d, const char *bit, const char *line) {
+    int b, low = 0;
+    char *end;
+    long l;
 
-static int fd = -1;
-#define LOCKFILE "/tmp/irlp-lockfile-parport0"
-static int lockfilefd = -1;
+    if( (bit[0] != 's' && bit[0] != 'd') || bit[1] < '0' || bit[1] > '7' ||
+            bit[2] != '\0' )
+        return -1;
+    b = (bit[0] == 'd' ? 8 : 0) + bit[1] - '0';
 
-int ppclaim() {
-    if( fd < 0 )         // device must be open to claim it
+    if( !strcmp(line, "-") ) {
+        d->map.line[b] = -1;
+        return 0;
+    }
+    if( *line == '!' ) {
+        low = 1;
+        ++line;
+    }
+    l = strtol(line, &end, 0);
+    if( end == line || *end != '\0' || l < 0 || l > 127 )
         return -1;
-    if( lockfilefd < 0 ) { // open lockfile once and never close
-        lockfilefd = open(LOCKFILE, O_WRONLY|O_CREAT, 0664);
-        if( lockfilefd < 0 ) { // We give up if this happens
-            perror("Can't open lock file "LOCKFILE);
-            exit(errno);
+    d->map.line[b] = l;
+    if( low )
+        d->map.low |= 1 << b;
+    else
+        d->map.low &= ~(1 << b);
+    return 0;
+}
+
+/*
+ * A descriptor that becomes readable when an input changes, -1 if the
+ * device can only be polled
+ */
+int irlpdev_evfd(struct irlpdev *d) {
+    return d->gpio ? d->fd : -1;
+}
+
+/*
+ * Use a device another controller opened and handed to us
+ */
+int irlpdev_adopt(struct irlpdev *d, int fd) {
+    if( d->gpio )
+        return gpio_adopt(d, fd);
+    d->fd = fd;
+    return fd;
+}
+
+/*
+ * A second handle to the same device. A parallel port is opened again,
+ * GPIO lines can only be requested once so the request is shared.
+ */
+int irlpdev_dup(struct irlpdev *d, struct irlpdev *copy) {
+    if( d->gpio ) {
+        *copy = *d;
+        copy->dup = 1;
+        copy->fd = d->fd < 0 ? -1 : fcntl(d->fd, F_DUPFD_CLOEXEC, 0);
+        return copy->fd;
+    }
+    irlpdev_init(copy, d->path);
+    copy->shmlock = d->shmlock;
+    copy->dup = 1;
+    return irlpdev_open(copy);
+}
+
+/*
+ * Open a second handle again once the device came back after an outage
+ */
+int irlpdev_redup(struct irlpdev *d, struct irlpdev *copy) {
+    irlpdev_close(copy);
+    if( d->gpio ) {
+        copy->fd = d->fd < 0 ? -1 : fcntl(d->fd, F_DUPFD_CLOEXEC, 0);
+        return copy->fd;
+    }
+    return irlpdev_open(copy);
+}
+
+/*
+ * Note a failure, the caller reports it if it asked for quiet. Keeps
+ * errno for the caller.
+ */
+void irlpdev_error(struct irlpdev *d, const char *op) {
+    d->err = errno;
+    d->errop = op;
+    if( !d->quiet )
+        fprintf(stderr, "%s %s: %s\n", op, d->path, strerror(d->err));
+    errno = d->err;
+}
+
+/*
+ * Serialize against the other users of the port, either through the IRLP
+ * lockfile or through the shared port lock
+ */
+static int pplock(struct irlpdev *d) {
+    if( d->shmlock ) {
+        if( d->plock == NULL && (d->plock = portlock_open(d->path)) == NULL )
+            return -1;
+        return portlock_take(d->plock);
+    }
+    if( d->lockfd < 0 ) { // open lockfile once and never close
+        d->lockfd = open(d->lockfile, O_WRONLY|O_CREAT, 0664);
+        if( d->lockfd < 0 ) {
+            irlpdev_error(d, "open lockfile");
+            return -1;
         }
     }
-    if( flock(lockfilefd, LOCK_EX) < 0 ) {  // We give up if this happens
-        perror("Can't optain exclusive lock on "LOCKFILE);
-        exit(errno);
+    while( flock(d->lockfd, LOCK_EX) < 0 ) {
+        if( errno == EINTR )
+            continue;
+        irlpdev_error(d, "flock");
+        return -1;
+    }
+    return 0;
+}
+
+static void ppunlock(struct irlpdev *d) {
+    if( d->shmlock ) {
+        if( d->plock )
+            portlock_give(d->plock);
+        return;
+    }
+    flock(d->lockfd, LOCK_UN);
+}
+
+int ppclaim(struct irlpdev *d) {
+    if( d->gpio )           // lines are ours alone, nothing to claim
+        return 0;
+    PROBE1(repeater, ppclaim_entry, d->fd);
+    if( d->fd < 0 ) {       // device must be open to claim it
+        PROBE2(repeater, ppclaim_return, d->fd, -1);
+        return -1;
     }
-    if( ioctl(fd, PPCLAIM) ) {
-        perror("PPCLAIM");
-        // Release the lockfile if claiming the device failed.
-           flock(lockfilefd, LOCK_UN);
+    if( pplock(d) < 0 ) {
+        PROBE2(repeater, ppclaim_return, d->fd, -1);
+        return -1;
+    }
+    if( ioctl(d->fd, PPCLAIM) ) {
+        irlpdev_error(d, "PPCLAIM");
+        // Release the lock if claiming the device failed.
+        ppunlock(d);
+        PROBE2(repeater, ppclaim_return, d->fd, -1);
         return -1;    
     }
+    PROBE2(repeater, ppclaim_return, d->fd, 0);
     return 0;
 }
 
-int pprelease() {
+int pprelease(struct irlpdev *d) {
     int ret = 0;
 
-    if( fd < 0 )
+    if( d->gpio )
+        return 0;
+    PROBE1(repeater, pprelease_entry, d->fd);
+    if( d->fd < 0 )
         ret = -1;
-    else if( ioctl(fd, PPRELEASE) ) {
-        perror("PPRELEASE");
+    else if( ioctl(d->fd, PPRELEASE) ) {
+        irlpdev_error(d, "PPRELEASE");
         ret = -1;
     }
-    flock(lockfilefd, LOCK_UN); // Make sure we always unlock.
+    ppunlock(d);    // Make sure we always unlock.
+    PROBE2(repeater, pprelease_return, d->fd, ret);
     return ret;
 }
 
-int irlpdev_open() {
-    if( fd >= 0 )
-        return fd; /* already open */
-    if( (fd = open("/dev/parport0", O_RDWR)) < 0 ) {
-        perror("open(\"/dev/parport0\") failed.");
+int irlpdev_open(struct irlpdev *d) {
+    if( d->fd >= 0 )
+        return d->fd; /* already open */
+    if( d->gpio )
+        return gpio_open(d);
+    if( (d->fd = open(d->path, O_RDWR)) < 0 ) {
+        irlpdev_error(d, "open");
         return -1;
     }
-    if( ppclaim() < 0 ) { /* trial claim */
-        perror("Trial PPCLAIM failed on /dev/parport0");
-        close(fd);
-        fd = -1;
+    if( ppclaim(d) < 0 ) { /* trial claim */
+        close(d->fd);
+        d->fd = -1;
         return -1;
     }
-    pprelease();
-    return fd;
+    pprelease(d);
+    return d->fd;
+}
+
+/*
+ * Let go of the device so the next irlpdev_open() opens it afresh
+ */
+void irlpdev_close(struct irlpdev *d) {
+    if( d->fd >= 0 )
+        close(d->fd);
+    d->fd = -1;
 }
 
-int read_irlpdev(unsigned char *buff, int n) {
+int read_irlpdev(struct irlpdev *d, unsigned char *buff, int n) {
+    unsigned char c[2];
     int k;
 
-    if( ppclaim() < 0 )
+    if( d->gpio ) {
+        if( gpio_read(d, c) < 0 )
+            return -1;
+        for( k = 0; k < n && k < 2; k++ )
+            buff[k] = c[k];
+        return k;
+    }
+
+    if( ppclaim(d) < 0 )
         return -1;
 
     k = 0;
     if( n > 0 ) {
-        if( ioctl(fd, PPRSTATUS, buff) ) {
-            perror("PPRSTATUS");
-            pprelease();
+        if( ioctl(d->fd, PPRSTATUS, buff) ) {
+            irlpdev_error(d, "PPRSTATUS");
+            pprelease(d);
             return -1;
         }
         k++;
     }    
     if( n > 1 ) {
-        if( ioctl(fd, PPRDATA, buff + 1) ) {
-            perror("PPRDATA");
-            pprelease();
+        if( ioctl(d->fd, PPRDATA, buff + 1) ) {
+            irlpdev_error(d, "PPRDATA");
+            pprelease(d);
             return -1;
         }
         k++;
     }
-    pprelease();
+    pprelease(d);
     return k;
 }
 
-int write_irlpdev(unsigned char *buff, int n) {
+int write_irlpdev(struct irlpdev *d, unsigned char *buff, int n) {
     int k;
 
-    if( ppclaim() < 0 )
+    if( d->gpio )
+        return n > 0 ? gpio_write(d, *buff, ~*buff) : 0;
+
+    if( ppclaim(d) < 0 )
         return -1;
 
     k = 0;
     if( n > 0 ) {
-        if( ioctl(fd, PPWDATA, buff) ) {
-            perror("PPWDATA");
-            pprelease();
+        if( ioctl(d->fd, PPWDATA, buff) ) {
+            irlpdev_error(d, "PPWDATA");
+            pprelease(d);
             return -1;
         }
         k++;
     }
-    pprelease();
+    pprelease(d);
     return k;
 }
+
+/*
+ * Set and clear bits of the data register under a single claim so nothing
+ * else can write the port between our read and our write. The old and the
+ * new data register end up in buff. GPIO writes just the lines in set and
+ * clr, the read is only for buff.
+ */
+int modify_irlpdev(struct irlpdev *d, unsigned char set, unsigned char clr,
+                   unsigned char *buff) {
+    unsigned char c[2];
+
+    if( d->gpio ) {
+        if( gpio_values(d, c) < 0 )
+            return -1;
+        buff[0] = c[1];
+        buff[1] = (buff[0] & ~clr) | set;
+        return gpio_write(d, set, clr) < 0 ? -1 : 2;
+    }
+    if( ppclaim(d) < 0 )
+        return -1;
+
+    if( ioctl(d->fd, PPRDATA, buff) ) {
+        irlpdev_error(d, "PPRDATA");
+        pprelease(d);
+        return -1;
+    }
+    buff[1] = (buff[0] & ~clr) | set;
+    if( ioctl(d->fd, PPWDATA, buff + 1) ) {
+        irlpdev_error(d, "PPWDATA");
+        pprelease(d);
+        return -1;
+    }
+    pprelease(d);
+    return 2;
+}
+
+/*
+ * Like modify_irlpdev() but without the lockfile, for the watchdog which
+ * must get through even when the lock holder is the one that is stuck.
+ */
+int force_irlpdev(struct irlpdev *d, unsigned char set, unsigned char clr) {
+    unsigned char c;
+    int ret = -1;
+
+    if( d->gpio )
+        return d->fd < 0 || gpio_write(d, set, clr) < 0 ? -1 : 0;
+
+    if( d->fd < 0 || ioctl(d->fd, PPCLAIM) )
+        return -1;
+    if( !ioctl(d->fd, PPRDATA, &c) ) {
+        c = (c & ~clr) | set;
+        if( !ioctl(d->fd, PPWDATA, &c) )
+            ret = 0;
+    }
+    ioctl(d->fd, PPRELEASE);
+    return ret;
+}
+
+/*
+ * Read the status register n times back to back under a single claim,
+ * and the data register once
+ */
+int burst_irlpdev(struct irlpdev *d, unsigned char *status, int n,
+                  unsigned char *data) {
+    unsigned char c[2];
+    int k;
+
+    if( ppclaim(d) < 0 )
+        return -1;
+    for( k = 0; k < n; k++ ) {
+        if( d->gpio ? gpio_read(d, c) < 0 :
+                ioctl(d->fd, PPRSTATUS, c) ) {
+            irlpdev_error(d, "PPRSTATUS");
+            pprelease(d);
+            return -1;
+        }
+        status[k] = c[0];
+    }
+    if( !d->gpio && ioctl(d->fd, PPRDATA, c + 1) ) {
+        irlpdev_error(d, "PPRDATA");
+        pprelease(d);
+        return -1;
+    }
+    *data = c[1];
+    pprelease(d);
+    return n;
+}
+
+/*
+ * Read status and data register of a port the caller has claimed. This
+ * is for sampling in a tight loop without the claim for every read.
+ */
+int sample_irlpdev(struct irlpdev *d, unsigned char *buff) {
+    if( d->gpio )
+        return gpio_read(d, buff);
+    if( ioctl(d->fd, PPRSTATUS, buff) )
+        return -1;
+    if( ioctl(d->fd, PPRDATA, buff + 1) )
+        return -1;
+    return 2;
+}
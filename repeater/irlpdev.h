@@ -1,3 +1,62 @@
-int irlpdev_open();
-int read_irlpdev(unsigned char *, int);
-int write_irlpdev(unsigned char *, int);
+#include <stdint.h>
+#include "portlock.h"
+
+/* Default device and lockfile prefix shared with the IRLP tools */
+#define IRLPDEV_PATH    "/dev/parport0"
+#define IRLPDEV_LOCK    "/tmp/irlp-lockfile-"
+
+/* A device by this name is a GPIO chip standing in for a parallel port */
+#define IRLPDEV_GPIO    "/dev/gpiochip"
+#define GPIOBITS        16      /* Status register bits 0-7, data 8-15 */
+
+/* Which GPIO line carries which bit of the parallel port registers */
+struct gpiomap {
+    signed char     line[GPIOBITS];     /* Line offset or -1 */
+    unsigned short  low;        /* Bits on active low lines */
+    unsigned char   datain;     /* Data register bits that are inputs */
+};
+
+struct irlpdev {
+    char    path[64];           /* Parallel port device */
+    char    lockfile[96];       /* Lockfile serializing claims */
+    int     fd;                 /* Open device or -1 */
+    int     lockfd;             /* Open lockfile or -1 */
+    int     shmlock;            /* Serialize through the shared port lock */
+    struct portlock *plock;     /* Mapped on the first claim */
+    int     gpio;               /* GPIO chip, fd holds the line request */
+    struct gpiomap map;
+    int     nlines;             /* Lines requested */
+    unsigned char bit[GPIOBITS];    /* Register bit of each line */
+    uint64_t edgeus;            /* Kernel time of the last input edge */
+    unsigned char seed;         /* Data byte GPIO outputs start with */
+    int     dup;                /* A second handle, of another thread */
+    int     quiet;              /* Leave reporting errors to the caller */
+    int     err;                /* errno of the last failure */
+    const char *errop;          /* And what failed */
+};
+
+void irlpdev_init(struct irlpdev *d, const char *path);
+int irlpdev_open(struct irlpdev *d);
+void irlpdev_close(struct irlpdev *d);
+void irlpdev_error(struct irlpdev *d, const char *op);
+int read_irlpdev(struct irlpdev *d, unsigned char *, int);
+int write_irlpdev(struct irlpdev *d, unsigned char *, int);
+int ppclaim(struct irlpdev *d);
+int pprelease(struct irlpdev *d);
+int modify_irlpdev(struct irlpdev *d, unsigned char set, unsigned char clr,
+                   unsigned char *buff);
+int force_irlpdev(struct irlpdev *d, unsigned char set, unsigned char clr);
+int sample_irlpdev(struct irlpdev *d, unsigned char *buff);
+int burst_irlpdev(struct irlpdev *d, unsigned char *status, int n,
+                  unsigned char *data);
+int irlpdev_dup(struct irlpdev *d, struct irlpdev *copy);
+int irlpdev_redup(struct irlpdev *d, struct irlpdev *copy);
+int irlpdev_line(struct irlpdev *d, const char *bit, const char *line);
+int irlpdev_evfd(struct irlpdev *d);
+int irlpdev_adopt(struct irlpdev *d, int fd);
+
+int gpio_open(struct irlpdev *d);
+int gpio_adopt(struct irlpdev *d, int fd);
+int gpio_read(struct irlpdev *d, unsigned char *buff);
+int gpio_values(struct irlpdev *d, unsigned char *buff);
+int gpio_write(struct irlpdev *d, unsigned char set, unsigned char clr);
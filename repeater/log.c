@@ -30,7 +30,10 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <syslog.h>
 #include <sys/time.h>
 #include "log.h"
@@ -38,17 +41,190 @@
 int verbose = 0;
 int logging = 0;
 
+/* Single producer, single consumer ring. Every thread that logs gets its
+ * own ring, the writer thread is the only consumer of all of them. A ring
+ * let go by a thread that ended is taken by the next one, what is left in
+ * it is still drained.
+ */
+struct logring {
+    struct logrec   rec[LOGRING];
+    unsigned int    head;           /* Written by the producer */
+    unsigned int    tail;           /* Written by the writer */
+    unsigned int    dropped;        /* Records lost to a full ring */
+    unsigned int    reported;       /* Drops already reported */
+    int             used;           /* Held by a thread */
+};
+
+static struct logring rings[LOGRINGS];
+static unsigned int nrings = 0;     /* Rings ever taken, drained */
+static unsigned int unringed = 0;   /* Events of threads without a ring */
+static unsigned int unreported = 0;
+static __thread struct logring *myring = NULL;
+static pthread_key_t ringkey;       /* Lets the ring go at thread exit */
+static pthread_once_t ringonce = PTHREAD_ONCE_INIT;
+static pthread_t writer;
+static volatile int running = 0;
+
+static void log_format(struct logrec *r, char *str, int sz);
+static void log_output(unsigned long long ts, char *str);
+
+/* Thread exit, the ring is free for the next thread */
+static void log_unring(void *q)
+{
+    __atomic_store_n(&((struct logring *)q)->used, 0, __ATOMIC_RELEASE);
+}
+
+static void log_keyinit()
+{
+    pthread_key_create(&ringkey, log_unring);
+}
+
+/* A free ring for this thread, NULL if all are held */
+static struct logring *log_ring()
+{
+    unsigned int i, n;
+    int free;
+
+    pthread_once(&ringonce, log_keyinit);
+    for (i = 0; i < LOGRINGS; ++i) {
+        free = 0;
+        if (!__atomic_compare_exchange_n(&rings[i].used, &free, 1, 0,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            continue;
+        n = __atomic_load_n(&nrings, __ATOMIC_ACQUIRE);
+        while (n < i + 1 && !__atomic_compare_exchange_n(&nrings, &n, i + 1,
+                0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            ;
+        pthread_setspecific(ringkey, &rings[i]);
+        return &rings[i];
+    }
+    return NULL;
+}
+
 /*
  * Print log line
  */
 void do_log(char *str)
 {
-    int sztime = 40;
-    char time[sztime];
+    log_event(EV_TEXT, str, NULL, 0);
+}
+
+/*
+ * Record a log event
+ *
+ * Never blocks. Without a writer thread the event is printed right away,
+ * which is what the short lived tools want.
+ */
+void log_event(int ev, const char *s1, const char *s2, long a)
+{
+    struct logring *q;
+    struct logrec *r;
+    struct timespec ts;
+    unsigned int head;
+    char str[255];
+
+    if (!verbose && !logging)
+        return;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    if (!running) {
+        struct logrec tmp;
+
+        tmp.ev = ev;
+        tmp.a = a;
+        tmp.s1 = s1;
+        tmp.s2 = s2;
+        tmp.txt[0] = '\0';
+        if (ev == EV_TEXT)
+            snprintf(tmp.txt, LOGTXT, "%s", s1);
+        log_format(&tmp, str, sizeof(str));
+        log_output(0, str);
+        return;
+    }
+
+    /* First event of this thread claims a ring */
+    if (myring == NULL && (myring = log_ring()) == NULL) {
+        __atomic_fetch_add(&unringed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    q = myring;
+
+    head = q->head;
+    if (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) >= LOGRING) {
+        q->dropped++;
+        return;
+    }
+
+    r = &q->rec[head & (LOGRING - 1)];
+    r->ts = (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    r->ev = ev;
+    r->a = a;
+    r->s1 = s1;
+    r->s2 = s2;
+    if (ev == EV_TEXT)
+        snprintf(r->txt, LOGTXT, "%s", s1);
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Turn a record into text
+ */
+static void log_format(struct logrec *r, char *str, int sz)
+{
+    switch (r->ev) {
+        case EV_TEXT:
+            snprintf(str, sz, "%s", r->txt);
+            break;
+        case EV_PORT:
+            snprintf(str, sz, "%s: %s", r->s1, r->s2);
+            break;
+        case EV_DOING:
+            snprintf(str, sz, "%s: Doing: %s", r->s1, r->s2);
+            break;
+        case EV_SCRIPT:
+            snprintf(str, sz, "%s: Script: [%ld] %s", r->s1, r->a, r->s2);
+            break;
+        case EV_EXITED:
+            snprintf(str, sz, "%s: Script: [%ld] exited", r->s1, r->a);
+            break;
+        case EV_FAILED:
+            snprintf(str, sz, "%s: Failed: %s", r->s1, r->s2);
+            break;
+        default:
+            snprintf(str, sz, "Unknown event %d", r->ev);
+    }
+}
+
+/*
+ * Send a line to stdout and syslog. A monotonic timestamp of 0 means now.
+ * The formatted time is cached and only redone when the second changes.
+ */
+static void log_output(unsigned long long ts, char *str)
+{
+    static time_t lastsec = -1;
+    static char tsbuf[40];
+    struct timespec mono, real;
+    unsigned long long wall;
+    time_t sec;
+    struct tm tm;
 
     if (verbose) {
-        timestamp(time, sztime);
-        fprintf(stdout, "[%s] %s\n", time, str);
+        clock_gettime(CLOCK_REALTIME, &real);
+        wall = (unsigned long long)real.tv_sec * 1000000000ULL + real.tv_nsec;
+        if (ts) {
+            /* Map the monotonic record time onto the wall clock */
+            clock_gettime(CLOCK_MONOTONIC, &mono);
+            wall -= (unsigned long long)mono.tv_sec * 1000000000ULL
+                    + mono.tv_nsec - ts;
+        }
+        sec = wall / 1000000000ULL;
+        if (sec != lastsec) {
+            localtime_r(&sec, &tm);
+            strftime(tsbuf, sizeof(tsbuf), "%b %d %H:%M:%S", &tm);
+            lastsec = sec;
+        }
+        fprintf(stdout, "[%s] %s\n", tsbuf, str);
     }
 
     if (logging) {
@@ -56,6 +232,97 @@ void do_log(char *str)
     }
 }
 
+/*
+ * Drain all rings, returns the number of records written
+ */
+static int log_drain()
+{
+    struct logring *q;
+    struct logrec *r;
+    unsigned int i, n, tail, head;
+    char str[255];
+    int k = 0;
+
+    n = __atomic_load_n(&nrings, __ATOMIC_ACQUIRE);
+
+    for (i = 0; i < n; ++i) {
+        q = &rings[i];
+        tail = q->tail;
+        head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+        while (tail != head) {
+            r = &q->rec[tail & (LOGRING - 1)];
+            log_format(r, str, sizeof(str));
+            log_output(r->ts, str);
+            ++tail;
+            ++k;
+        }
+        __atomic_store_n(&q->tail, tail, __ATOMIC_RELEASE);
+
+        if (q->dropped != q->reported) {
+            snprintf(str, sizeof(str), "Log: %u messages dropped",
+                     q->dropped - q->reported);
+            q->reported = q->dropped;
+            log_output(0, str);
+            ++k;
+        }
+    }
+
+    n = __atomic_load_n(&unringed, __ATOMIC_RELAXED);
+    if (n != unreported) {
+        snprintf(str, sizeof(str), "Log: %u messages dropped, more than %d "
+                 "threads log at once", n - unreported, LOGRINGS);
+        unreported = n;
+        log_output(0, str);
+        ++k;
+    }
+    return k;
+}
+
+/*
+ * The writer thread
+ */
+static void *log_writer(void *arg)
+{
+    struct timespec tim;
+
+    tim.tv_sec = 0;
+    tim.tv_nsec = LOGPOLL * 1000000;
+
+    while (running) {
+        if (log_drain())
+            fflush(stdout);
+        nanosleep(&tim, NULL);
+    }
+    log_drain();
+    fflush(stdout);
+    return NULL;
+}
+
+/*
+ * Move formatting and output off the calling thread
+ */
+void log_start()
+{
+    if (running)
+        return;
+    running = 1;
+    if (pthread_create(&writer, NULL, log_writer, NULL)) {
+        running = 0;
+        fprintf(stderr, "Can't start log writer, logging synchronously\n");
+    }
+}
+
+/*
+ * Flush what is pending and stop the writer thread
+ */
+void log_stop()
+{
+    if (!running)
+        return;
+    running = 0;
+    pthread_join(writer, NULL);
+}
+
 /* 
  * Update timestamp 
  */
@@ -83,5 +350,5 @@ void open_syslog(char *nam)
  */
 void write_syslog(char *str)
 {
-    syslog(LOG_INFO, str);
+    syslog(LOG_INFO, "%s", str);
 }
@@ -30,7 +30,44 @@
 extern int verbose;
 extern int logging;
 
+/* Log events
+ *
+ * The hot path records an event id with its arguments and a monotonic
+ * timestamp. Once log_start() ran, a writer thread formats the records and
+ * passes them on to stdout and syslog. String arguments are not copied and
+ * must be static, EV_TEXT is the exception and copies up to LOGTXT bytes.
+ *
+ * A thread takes a ring with its first event and lets it go when it ends.
+ * The main loop and the watchdog log, the PWM and beacon threads are
+ * started from the main loop and leave logging to it, so LOGRINGS leaves
+ * room for two more. Events of a thread beyond are dropped, counted and
+ * reported by the writer.
+ */
+#define EV_TEXT     0           /* Free text */
+#define EV_PORT     1           /* Port message: port, text */
+#define EV_DOING    2           /* Pin change: port, name */
+#define EV_SCRIPT   3           /* Script started: port, script, pid */
+#define EV_EXITED   4           /* Script exited: port, pid */
+#define EV_FAILED   5           /* Script not started: port, script */
+
+#define LOGTXT      80          /* Max length of EV_TEXT */
+#define LOGRING     256         /* Records per ring, power of two */
+#define LOGRINGS    4           /* Threads logging at once */
+#define LOGPOLL     10          /* Writer poll interval in ms */
+
+struct logrec {
+    unsigned long long  ts;     /* CLOCK_MONOTONIC in ns */
+    int                 ev;     /* Event id */
+    long                a;      /* Numeric argument */
+    const char          *s1;    /* Static string arguments */
+    const char          *s2;
+    char                txt[LOGTXT];
+};
+
 void do_log(char *str);
+void log_event(int ev, const char *s1, const char *s2, long a);
+void log_start();
+void log_stop();
 void timestamp(char *buf, int sz);
 void open_syslog(char *nam);
 void write_syslog(char *str);
@@ -31,8 +31,11 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <errno.h>
+#include "irlpdev.h"
 #include "portctl_lib.h"
 #include "log.h"
+#include "control.h"
 #include "repeater.h"
 
 #define PROG    "portctl"
@@ -40,6 +43,9 @@
 static char *usage =
     "Usage: portctl [OPTION] CMD [CMD ...]\n"
     "Alter IRLP port state.\n"
+    "   -p      port DEVICE[,SETTING=VALUE,...]\n"
+    "   -c      control socket PATH of the repeater, default " CTLSOCK "\n"
+    "   -d      drive the port directly even if the repeater runs\n"
     "   -l      log to syslog\n"
     "   -v      clutter the screen\n"
     "   -h      display this help and exit\n"
@@ -47,6 +53,15 @@ static char *usage =
 
 int main(int argc, char *argv[])
 {
+    struct port port;
+    unsigned char set = 0, clr = 0;
+    char cmds[LOGTXT];
+    char req[CTLMSG], reply[CTLMSG];
+    char *ctlpath = CTLSOCK;     /* Where the repeater listens */
+    int direct = 0;              /* Skip the repeater */
+    int len = 0, n, i;
+
+    port_init(&port, IRLPDEV_PATH);
 
     /* Get any optional command line args (start with -) */
     while (argc > 1 && *argv[1] == '-') {
@@ -60,6 +75,22 @@ int main(int argc, char *argv[])
         if (!strcmp(argv[1], "-l")) {
             logging = 1;
         }
+        if (!strcmp(argv[1], "-d")) {
+            direct = 1;
+        }
+        if (!strcmp(argv[1], "-c") && argc > 2) {
+            ctlpath = argv[2];
+            --argc;
+            ++argv;
+        }
+        if (!strcmp(argv[1], "-p") && argc > 2) {
+            if (port_config(&port, argv[2]) < 0) {
+                fprintf(stderr, "Invalid port %s\n", argv[2]);
+                return -1;
+            }
+            --argc;
+            ++argv;
+        }
         --argc;
         ++argv;
     }
@@ -69,41 +100,50 @@ int main(int argc, char *argv[])
         return -1;
     }
 
-    /* Open syslog */
-    if (logging)
-        open_syslog(PROG);
+    /* A running repeater owns the port, ask it to do the work so it
+     * knows about it. Without one we drive the port ourselves.
+     */
+    if (!direct) {
+        n = snprintf(req, sizeof(req), "%s", port.name);
+        for (i = 1; i < argc && n < sizeof(req); ++i)
+            n += snprintf(req + n, sizeof(req) - n, " %s", argv[i]);
+        if (ctl_request(ctlpath, req, reply, sizeof(reply)) >= 0) {
+            if (!strncmp(reply, "error", 5)) {
+                fprintf(stderr, "%s", reply);
+                return -1;
+            }
+            if (verbose)
+                printf("%s", reply);
+            return 0;
+        }
+        if (errno != ENOENT && errno != ECONNREFUSED) {
+            fprintf(stderr, "Repeater not answering on %s: %s\n",
+                    ctlpath, strerror(errno));
+            return -1;
+        }
+    }
 
-    /* Perform command */
+    /* Fold all commands into one set of masks */
+    cmds[0] = '\0';
     while (argc >  1) {
-        if (!strcmp(argv[1], "key"))
-            key();
-        if (!strcmp(argv[1], "keyup"))
-            keyup();
-        if (!strcmp(argv[1], "unkey"))
-            unkey();
-        if (!strcmp(argv[1], "mute"))
-            mute();
-        if (!strcmp(argv[1], "unmute"))
-            unmute();
-        if (!strcmp(argv[1], "ctcsson"))
-            ctcsson();
-        if (!strcmp(argv[1], "ctcssoff"))
-            ctcssoff();
-        if (!strcmp(argv[1], "fanon"))
-            fanon();
-        if (!strcmp(argv[1], "fanoff"))
-            fanoff();
-        if (!strcmp(argv[1], "aux4on"))
-            aux4on();
-        if (!strcmp(argv[1], "aux4off"))
-            aux4off();
-        if (!strcmp(argv[1], "aux5on"))
-            aux5on();
-        if (!strcmp(argv[1], "aux5off"))
-            aux5off();
+        if (port_command(&port, argv[1], &set, &clr) < 0) {
+            fprintf(stderr, "Unknown command %s\n", argv[1]);
+            return -1;
+        }
+        if (len < sizeof(cmds))
+            len += snprintf(cmds + len, sizeof(cmds) - len, "%s%s",
+                            len ? " " : "", argv[1]);
         --argc;
         ++argv;
     }
 
+    /* Open syslog */
+    if (logging)
+        open_syslog(PROG);
+
+    /* Perform the commands in a single port transaction */
+    if (portctl_masks(&port, set, clr, cmds) < 0)
+        return -1;
+
     return 0;
 }
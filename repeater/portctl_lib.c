@@ -30,10 +30,212 @@
  */
 
 #include <stdio.h>
-#include "portctl_lib.h"
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/time.h>
 #include "irlpdev.h"
+#include "portctl_lib.h"
 #include "log.h"
+#include "recorder.h"
 #include "repeater.h"
+#include "probes.h"
+
+/*
+ * port_init, port_config
+ *
+ * Set up a port with the default IRLP board pin assignment. The config
+ * takes a device optionally followed by comma separated settings, e.g.
+ *
+ *   /dev/parport1,name=rpt2,sound=plughw:1,fan=0x40,aux5=0x20
+ *
+ * Settings are name, sound, lock (flock or shm, see portlock.h) and the
+ * pin masks cos, irlpkey, key, mute, ctcss, fan, aux4 and aux5. The COS
+ * and DTMF inputs are conditioned with cosfilter and dtmffilter (none, maj
+ * or int:K, see filter.h) over bursts of burst reads. A GPIO chip takes
+ * the lines of the register bits s0-s7 and d0-d7 as well, e.g.
+ *
+ *   /dev/gpiochip0,s7=17,d1=!27,d2=22
+ */
+void port_init(struct port *p, const char *path)
+{
+    const char *base;
+
+    memset(p, 0, sizeof(*p));
+    irlpdev_init(&p->dev, path);
+    base = strrchr(path, '/');
+    snprintf(p->name, sizeof(p->name), "%s", base ? base + 1 : path);
+
+    p->pins.cos = IRLPDEV_BUS;
+    p->pins.irlpkey = IRLPKEY;
+    p->pins.key = KEY;
+    p->pins.mute = MUTE;
+    p->pins.ctcss = CTCSS;
+    p->pins.fan = FAN;
+    p->pins.aux4 = AUX4;
+    p->pins.aux5 = AUX5;
+    p->dev.map.datain = p->pins.irlpkey;
+    p->pwm.hz = PWMHZ;
+    p->pwm.min = PWMMIN;
+    p->pwm.max = PWMMAX;
+    p->beacon.wpm = BEACONWPM;
+    p->beacon.every = BEACONEVERY;
+}
+
+int port_config(struct port *p, char *spec)
+{
+    char *tok, *val;
+    unsigned char *pin;
+
+    tok = strtok(spec, ",");
+    if (tok == NULL)
+        return -1;
+    port_init(p, tok);
+
+    while ((tok = strtok(NULL, ",")) != NULL) {
+        val = strchr(tok, '=');
+        if (val == NULL)
+            return -1;
+        *val++ = '\0';
+
+        if (!strcmp(tok, "name")) {
+            snprintf(p->name, sizeof(p->name), "%s", val);
+            continue;
+        }
+        if (!strcmp(tok, "sound")) {
+            snprintf(p->sound, sizeof(p->sound), "%s", val);
+            continue;
+        }
+        if (!strcmp(tok, "cosfilter")) {
+            if (filter_parse(&p->filter.line[LINE_COS], val) < 0)
+                return -1;
+            continue;
+        }
+        if (!strcmp(tok, "dtmffilter")) {
+            if (filter_parse(&p->filter.line[LINE_DTMF], val) < 0)
+                return -1;
+            continue;
+        }
+        if (!strcmp(tok, "burst")) {
+            p->filter.burst = strtol(val, NULL, 0);
+            if (p->filter.burst < 1 || p->filter.burst > BURSTMAX)
+                return -1;
+            continue;
+        }
+        if (!strcmp(tok, "pwm")) {
+            if (strcmp(val, "fan") && strcmp(val, "aux5"))
+                return -1;
+            p->pwm.pin = 1;         /* The bit is known once all are */
+            p->pwm.aux5 = !strcmp(val, "aux5");
+            continue;
+        }
+        if (!strcmp(tok, "pwmhz")) {
+            p->pwm.hz = strtol(val, NULL, 0);
+            if (p->pwm.hz < 1 || p->pwm.hz > PWMMAXHZ)
+                return -1;
+            continue;
+        }
+        if (!strcmp(tok, "pwmmin")) {
+            p->pwm.min = strtol(val, NULL, 0);
+            if (p->pwm.min < 0 || p->pwm.min > 100)
+                return -1;
+            continue;
+        }
+        if (!strcmp(tok, "pwmmax")) {
+            p->pwm.max = strtol(val, NULL, 0);
+            if (p->pwm.max < 0 || p->pwm.max > 100)
+                return -1;
+            continue;
+        }
+        if (!strcmp(tok, "beacon")) {
+            snprintf(p->beacon.text, sizeof(p->beacon.text), "%s", val);
+            continue;
+        }
+        if (!strcmp(tok, "beaconwpm")) {
+            p->beacon.wpm = strtol(val, NULL, 0);
+            if (p->beacon.wpm < BEACONMINWPM || p->beacon.wpm > BEACONMAXWPM)
+                return -1;
+            continue;
+        }
+        if (!strcmp(tok, "beaconevery")) {
+            p->beacon.every = strtol(val, NULL, 0);
+            if (p->beacon.every < 0 || p->beacon.every > 86400)
+                return -1;
+            continue;
+        }
+        if (!strcmp(tok, "lock")) {
+            if (strcmp(val, "shm") && strcmp(val, "flock"))
+                return -1;
+            p->dev.shmlock = !strcmp(val, "shm");
+            continue;
+        }
+
+        if (p->dev.gpio && irlpdev_line(&p->dev, tok, val) == 0)
+            continue;
+
+        pin = NULL;
+        if (!strcmp(tok, "cos"))        pin = &p->pins.cos;
+        if (!strcmp(tok, "irlpkey"))    pin = &p->pins.irlpkey;
+        if (!strcmp(tok, "key"))        pin = &p->pins.key;
+        if (!strcmp(tok, "mute"))       pin = &p->pins.mute;
+        if (!strcmp(tok, "ctcss"))      pin = &p->pins.ctcss;
+        if (!strcmp(tok, "fan"))        pin = &p->pins.fan;
+        if (!strcmp(tok, "aux4"))       pin = &p->pins.aux4;
+        if (!strcmp(tok, "aux5"))       pin = &p->pins.aux5;
+        if (pin == NULL)
+            return -1;
+        *pin = strtol(val, NULL, 0);
+    }
+    p->dev.map.datain = p->pins.irlpkey;
+    if (p->pwm.min > p->pwm.max)
+        return -1;
+    if (p->pwm.pin)
+        p->pwm.pin = p->pwm.aux5 ? p->pins.aux5 : p->pins.fan;
+    if (p->beacon.text[0])
+        p->beacon.pin = p->pins.aux5;
+    if (p->beacon.pin && p->beacon.pin == p->pwm.pin)
+        return -1;
+    if (!p->filter.burst)
+        p->filter.burst = filter_active(&p->filter) ? BURSTDEF : 1;
+    return 0;
+}
+
+static uint64_t usnow()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/*
+ * port_read
+ *
+ * Read status and data register of a port, with the COS and DTMF inputs
+ * conditioned over a burst of reads if the port filters them. edgeus
+ * tells when the inputs last changed, if the device or the filter knows.
+ */
+int port_read(struct port *p, unsigned char *c)
+{
+    unsigned char status[BURSTMAX], masks[FILTERLINES];
+    uint64_t start, end;
+    int n = p->filter.burst, k;
+
+    if (n <= 1) {
+        k = read_irlpdev(&p->dev, c, 2);
+        p->edgeus = p->dev.edgeus;
+        return k;
+    }
+
+    start = usnow();
+    if (burst_irlpdev(&p->dev, status, n, c + 1) != n)
+        return -1;
+    end = usnow();
+    masks[LINE_COS] = p->pins.cos;
+    masks[LINE_DTMF] = 0x78;
+    c[0] = filter_run(&p->filter, masks, status, n, start, end, &p->edgeus);
+    return 2;
+}
 
 /*
  * key, keyup, unkey
@@ -45,27 +247,27 @@
  * unkey:        0      (LOW)
  * keyup, key:   1      (HIGH)
  */
-int unkey()
+int unkey(struct port *p)
 {
     int pin = LOW;
-    char mask = KEY;
-    portctl(mask, pin, "unkey");
+    unsigned char mask = p->pins.key;
+    portctl(p, mask, pin, "unkey");
     return OFF;
 }
 
-int key()
+int key(struct port *p)
 {
     int pin = HIGH;
-    char mask = KEY;
-    portctl(mask, pin, "key");
+    unsigned char mask = p->pins.key;
+    portctl(p, mask, pin, "key");
     return ON;
 }
 
-int keyup()
+int keyup(struct port *p)
 {
     int pin = HIGH;
-    char mask = KEY;
-    portctl(mask, pin, "keyup");
+    unsigned char mask = p->pins.key;
+    portctl(p, mask, pin, "keyup");
     return ON;
 }
 
@@ -80,19 +282,19 @@ int keyup()
  * unmute:       1      (HIGH)
  * mute:         1      (LOW) 
  */
-int unmute()
+int unmute(struct port *p)
 {
     int pin = HIGH;
-    char mask = MUTE;
-    portctl(mask, pin, "unmute");
+    unsigned char mask = p->pins.mute;
+    portctl(p, mask, pin, "unmute");
     return OFF;
 }
 
-int mute()
+int mute(struct port *p)
 {
     int pin = LOW;
-    char mask = MUTE;
-    portctl(mask, pin, "mute");
+    unsigned char mask = p->pins.mute;
+    portctl(p, mask, pin, "mute");
     return ON;
 }
 
@@ -107,19 +309,19 @@ int mute()
  * ctcssooff:    1      (HIGH)
  * ctcsson:      0      (LOW) 
  */
-int ctcssoff()
+int ctcssoff(struct port *p)
 {
     int pin = HIGH;
-    char mask = CTCSS;
-    portctl(mask, pin, "ctcssoff");
+    unsigned char mask = p->pins.ctcss;
+    portctl(p, mask, pin, "ctcssoff");
     return OFF;
 }
 
-int ctcsson()
+int ctcsson(struct port *p)
 {
     int pin = LOW;
-    char mask = CTCSS;
-    portctl(mask, pin, "ctcsson");
+    unsigned char mask = p->pins.ctcss;
+    portctl(p, mask, pin, "ctcsson");
     return ON;
 }
 
@@ -133,35 +335,35 @@ int ctcsson()
  * fanoff, aux4off 0      (LOW)
  * fanon, aux4on   1      (HIGH)
  */
-int fanoff()
+int fanoff(struct port *p)
 {
     int pin = LOW;
-    char mask = FAN;
-    portctl(mask, pin, "fanoff");
+    unsigned char mask = p->pins.fan;
+    portctl(p, mask, pin, "fanoff");
     return OFF;
 }
 
-int aux4off()
+int aux4off(struct port *p)
 {
     int pin = LOW;
-    char mask = AUX4;
-    portctl(mask, pin, "aux4off");
+    unsigned char mask = p->pins.aux4;
+    portctl(p, mask, pin, "aux4off");
     return OFF;
 }
 
-int fanon()
+int fanon(struct port *p)
 {
     int pin = HIGH;
-    char mask = FAN;
-    portctl(mask, pin, "fanon");
+    unsigned char mask = p->pins.fan;
+    portctl(p, mask, pin, "fanon");
     return ON;
 }
 
-int aux4on()
+int aux4on(struct port *p)
 {
     int pin = HIGH;
-    char mask = AUX4;
-    portctl(mask, pin, "aux4on");
+    unsigned char mask = p->pins.aux4;
+    portctl(p, mask, pin, "aux4on");
     return ON;
 }
 
@@ -174,50 +376,111 @@ int aux4on()
  * aux5off:      0      (LOW)
  * aux5on:       1      (HIGH)
  */
-int aux5off()
+int aux5off(struct port *p)
 {
     int pin = LOW;
-    char mask = AUX5;
-    portctl(mask, pin, "aux5off");
+    unsigned char mask = p->pins.aux5;
+    portctl(p, mask, pin, "aux5off");
     return OFF;
 }
 
-int aux5on()
+int aux5on(struct port *p)
 {
     int pin = HIGH;
-    char mask = AUX5;
-    portctl(mask, pin, "aux5on");
+    unsigned char mask = p->pins.aux5;
+    portctl(p, mask, pin, "aux5on");
     return ON;
 }
 
+/*
+ * The commands by name, the pin they drive and the level they drive it to
+ */
+static struct portcmd {
+    char            *name;
+    size_t          pin;        /* Offset of the mask in struct pinmap */
+    int             state;
+} portcmds[] = {
+    { "key",        offsetof(struct pinmap, key),       HIGH },
+    { "keyup",      offsetof(struct pinmap, key),       HIGH },
+    { "unkey",      offsetof(struct pinmap, key),       LOW },
+    { "mute",       offsetof(struct pinmap, mute),      LOW },
+    { "unmute",     offsetof(struct pinmap, mute),      HIGH },
+    { "ctcsson",    offsetof(struct pinmap, ctcss),     LOW },
+    { "ctcssoff",   offsetof(struct pinmap, ctcss),     HIGH },
+    { "fanon",      offsetof(struct pinmap, fan),       HIGH },
+    { "fanoff",     offsetof(struct pinmap, fan),       LOW },
+    { "aux4on",     offsetof(struct pinmap, aux4),      HIGH },
+    { "aux4off",    offsetof(struct pinmap, aux4),      LOW },
+    { "aux5on",     offsetof(struct pinmap, aux5),      HIGH },
+    { "aux5off",    offsetof(struct pinmap, aux5),      LOW },
+    { NULL,         0,                                  0 }
+};
+
+/*
+ * port_command
+ *
+ * Fold a command into the bits to set and the bits to clear. A later
+ * command wins over an earlier one on the same pin. Returns the level
+ * driven or -1 for an unknown command.
+ */
+int port_command(struct port *p, const char *name, unsigned char *set,
+                 unsigned char *clr)
+{
+    struct portcmd *pc;
+    unsigned char mask;
+
+    for (pc = portcmds; pc->name != NULL; ++pc) {
+        if (strcmp(pc->name, name))
+            continue;
+        mask = *((unsigned char *)&p->pins + pc->pin);
+        if (pc->state == HIGH) {
+            *set |= mask;
+            *clr &= ~mask;
+        } else {
+            *clr |= mask;
+            *set &= ~mask;
+        }
+        return pc->state;
+    }
+    return -1;
+}
+
 /*
  * The portctl function
  */
-int portctl(char mask, int pin, char *name) 
+int portctl(struct port *p, unsigned char mask, int pin, char *name) 
+{
+    if (pin == HIGH)
+        portctl_masks(p, mask, 0, name);
+    if (pin == LOW)
+        portctl_masks(p, 0, mask, name);
+    return pin;
+}
+
+/*
+ * Apply set and clear masks in one read-modify-write of the data register
+ */
+int portctl_masks(struct port *p, unsigned char set, unsigned char clr,
+                  char *name)
 {
-    unsigned char out;
     unsigned char c[2];
-    char str[255];              /* String for logging */
 
-    sprintf(str, "Doing: %s", name);
-    do_log(str);
+    if (name != NULL)
+        log_event(EV_DOING, p->name, name, 0);
 
     /* Open the port */
-    if ( irlpdev_open() < 0 ) {
+    if ( irlpdev_open(&p->dev) < 0 ) {
         fprintf(stderr, "Can't open parallel port");
-        return pin;
+        return -1;
     }
 
-    /* Read current port status */
-    if (read_irlpdev(c, 2)  != 2) return pin;
-
-    /* Set the appropriate bits */
-    if (pin == HIGH)  out = (c[1] | mask);
-    if (pin == LOW) out = (c[1] & ~mask);
+    /* Read, set the appropriate bits and write under one claim */
+    if (modify_irlpdev(&p->dev, set, clr, c) != 2)
+        return -1;
+    rec_put(REC_OUTPUT, p->id, c[0], c[1]);
+    PROBE4(repeater, output, p->id, c[0], c[1], name);
+    p->out = c[1];
 
-    /* Write the new pin o hardware */
-    if (write_irlpdev(&out, 1) != 1) return pin;
-
-    return pin;
-} 
+    return 0;
+}
 
@@ -27,17 +27,91 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-int unkey();
-int key();
-int keyup();
-int unmute();
-int mute();
-int ctcssoff();
-int ctcsson();
-int fanoff();
-int aux4off();
-int fanon();
-int aux4on();
-int aux5off();
-int aux5on();
-int portctl(char mask, int state, char *name);
+#include "filter.h"
+
+#define MAXPORTS        4       /* Ports handled by one controller */
+
+/* Software PWM defaults */
+#define PWMHZ           25
+#define PWMMAXHZ        100     /* Two port writes a period, 200 a second */
+#define PWMMIN          30      /* Duty in percent while idle */
+#define PWMMAX          100     /* and while transmitting all the time */
+
+/* CW beacon defaults */
+#define BEACONTEXT      48
+#define BEACONWPM       20
+#define BEACONMINWPM    5
+#define BEACONMAXWPM    40
+#define BEACONEVERY     600     /* Seconds from one send to the next */
+
+/* Pin assignment of one IRLP style board */
+struct pinmap {
+    unsigned char   cos;        /* Status bit carrying COS */
+    unsigned char   irlpkey;    /* Data bit the IRLP software keys with */
+    unsigned char   key;        /* Data bits we drive */
+    unsigned char   mute;
+    unsigned char   ctcss;
+    unsigned char   fan;
+    unsigned char   aux4;
+    unsigned char   aux5;
+};
+
+/* Software PWM on FAN or AUX5, the duty follows the transmitter duty
+ * cycle from min to max
+ */
+struct pwmconf {
+    unsigned char   pin;        /* Data bit driven, 0 for none */
+    int             aux5;       /* AUX5 rather than FAN */
+    int             hz;
+    int             min;        /* Duty in percent */
+    int             max;
+};
+
+/* CW beacon keyed on AUX5, for a second transmitter sending a keyed
+ * carrier
+ */
+struct beaconconf {
+    unsigned char   pin;        /* Data bit keyed, 0 for none */
+    char            text[BEACONTEXT];
+    int             wpm;
+    int             every;      /* Seconds, 0 to send back to back */
+};
+
+/* One repeater port: the device, its pin map and the sound device the
+ * scripts of this port play on
+ */
+struct port {
+    int             id;         /* Index within the controller */
+    char            name[16];
+    char            sound[32];
+    struct irlpdev  dev;
+    struct pinmap   pins;
+    unsigned char   out;        /* Data register we last wrote */
+    struct portfilter filter;   /* Conditioning of the inputs */
+    uint64_t        edgeus;     /* When the inputs last changed, if known */
+    struct pwmconf  pwm;        /* Software PWM of an output */
+    struct beaconconf beacon;
+};
+
+void port_init(struct port *p, const char *path);
+int port_config(struct port *p, char *spec);
+int port_read(struct port *p, unsigned char *c);
+
+int unkey(struct port *p);
+int key(struct port *p);
+int keyup(struct port *p);
+int unmute(struct port *p);
+int mute(struct port *p);
+int ctcssoff(struct port *p);
+int ctcsson(struct port *p);
+int fanoff(struct port *p);
+int aux4off(struct port *p);
+int fanon(struct port *p);
+int aux4on(struct port *p);
+int aux5off(struct port *p);
+int aux5on(struct port *p);
+int portctl(struct port *p, unsigned char mask, int state, char *name);
+int port_command(struct port *p, const char *name, unsigned char *set,
+                 unsigned char *clr);
+int portctl_masks(struct port *p, unsigned char set, unsigned char clr,
+                  char *name);
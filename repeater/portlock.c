@@ -0,0 +1,223 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/prctl.h>
+#include "portlock.h"
+
+static uint64_t mono_us()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Segment name of a device, /irlp-lock- followed by its base name */
+static void portlock_name(const char *path, char *name, size_t n)
+{
+    const char *base = strrchr(path, '/');
+
+    snprintf(name, n, PORTLOCK_SHM "%s", base ? base + 1 : path);
+}
+
+static void portlock_setup(struct portlock *l)
+{
+    pthread_mutexattr_t attr;
+
+    memset(l, 0, sizeof(*l));
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    if (pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT) ||
+            pthread_mutex_init(&l->mutex, &attr)) {
+        /* No priority inheritance here, robust alone still does */
+        pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_NONE);
+        pthread_mutex_init(&l->mutex, &attr);
+    }
+    pthread_mutexattr_destroy(&attr);
+    l->version = PORTLOCK_VERSION;
+    __atomic_store_n(&l->magic, PORTLOCK_MAGIC, __ATOMIC_RELEASE);
+}
+
+/*
+ * Map the lock of a device, creating it if this is the first user
+ */
+struct portlock *portlock_open(const char *path)
+{
+    struct portlock *l;
+    char name[64];
+    int fd, made = 1, i;
+
+    portlock_name(path, name, sizeof(name));
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0666);
+    if (fd >= 0) {
+        fchmod(fd, 0666);       /* Whatever our umask, all tools share it */
+        if (ftruncate(fd, sizeof(struct portlock)) < 0) {
+            fprintf(stderr, "Can't size %s: %s\n", name, strerror(errno));
+            close(fd);
+            shm_unlink(name);
+            return NULL;
+        }
+    } else if (errno == EEXIST) {
+        made = 0;
+        fd = shm_open(name, O_RDWR, 0);
+    }
+    if (fd < 0) {
+        fprintf(stderr, "Can't open %s: %s\n", name, strerror(errno));
+        return NULL;
+    }
+
+    /* Someone else may still be sizing the segment */
+    for (i = 0; !made && i < 100; ++i) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(*l))
+            break;
+        usleep(1000);
+    }
+    l = mmap(NULL, sizeof(struct portlock), PROT_READ | PROT_WRITE,
+             MAP_SHARED, fd, 0);
+    close(fd);
+    if (l == MAP_FAILED) {
+        fprintf(stderr, "Can't map %s: %s\n", name, strerror(errno));
+        return NULL;
+    }
+
+    if (made) {
+        portlock_setup(l);
+        return l;
+    }
+    for (i = 0; i < 100; ++i) {
+        if (__atomic_load_n(&l->magic, __ATOMIC_ACQUIRE) == PORTLOCK_MAGIC)
+            break;
+        usleep(1000);
+    }
+    if (l->magic != PORTLOCK_MAGIC || l->version != PORTLOCK_VERSION) {
+        fprintf(stderr, "%s is not a port lock of this version\n", name);
+        munmap(l, sizeof(struct portlock));
+        return NULL;
+    }
+    return l;
+}
+
+/*
+ * Map the lock of a device read only for a reader, NULL if unused
+ */
+struct portlock *portlock_map(const char *path)
+{
+    struct portlock *l;
+    char name[64];
+    int fd;
+
+    portlock_name(path, name, sizeof(name));
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+    l = mmap(NULL, sizeof(struct portlock), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (l == MAP_FAILED)
+        return NULL;
+    if (l->magic != PORTLOCK_MAGIC || l->version != PORTLOCK_VERSION) {
+        munmap(l, sizeof(struct portlock));
+        return NULL;
+    }
+    return l;
+}
+
+/*
+ * Take the lock. The first attempt never leaves user space, only when it
+ * is held we note the holder and time the wait.
+ */
+int portlock_take(struct portlock *l)
+{
+    char blocker[16], comm[16];
+    uint64_t start = 0, wait = 0;
+    int ret;
+
+    ret = pthread_mutex_trylock(&l->mutex);
+    if (ret == EBUSY) {
+        memcpy(blocker, l->comm, sizeof(blocker));
+        start = mono_us();
+        ret = pthread_mutex_lock(&l->mutex);
+        wait = mono_us() - start;
+    }
+    if (ret == EOWNERDEAD) {
+        /* The port itself was released when the holder's fd closed */
+        fprintf(stderr, "Holder %d of the port lock died, recovered\n",
+                (int)l->holder);
+        l->lastdead = l->holder;
+        l->deaths++;
+        pthread_mutex_consistent(&l->mutex);
+        ret = 0;
+    }
+    if (ret) {
+        fprintf(stderr, "Can't take the port lock: %s\n", strerror(ret));
+        return -1;
+    }
+
+    memset(comm, 0, sizeof(comm));
+    prctl(PR_GET_NAME, comm);
+    l->holder = getpid();
+    memcpy(l->comm, comm, sizeof(l->comm));
+    l->since = mono_us();
+    l->claims++;
+    if (start) {
+        l->contended++;
+        l->waitus += wait;
+        if (wait > l->maxwaitus) {
+            l->maxwaitus = wait;
+            memcpy(l->maxwaiter, comm, sizeof(l->maxwaiter));
+            memcpy(l->maxblocker, blocker, sizeof(l->maxblocker));
+        }
+    }
+    return 0;
+}
+
+void portlock_give(struct portlock *l)
+{
+    uint64_t hold;
+
+    if (l->holder != getpid())  /* Not ours, the claim failed */
+        return;
+    hold = mono_us() - l->since;
+    l->holdus += hold;
+    if (hold > l->maxholdus) {
+        l->maxholdus = hold;
+        memcpy(l->maxholder, l->comm, sizeof(l->maxholder));
+    }
+    l->holder = 0;
+    pthread_mutex_unlock(&l->mutex);
+}
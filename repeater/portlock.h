@@ -0,0 +1,76 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Shared port lock
+ *
+ * An alternative to the flock() on the IRLP lockfile for processes that
+ * share a port. A robust, process shared mutex lives in a POSIX shared
+ * memory segment named after the port, /irlp-lock-parport0 for
+ * /dev/parport0. Taking it uncontended is an atomic operation in user
+ * space, a waiter sleeps in the kernel and the holder inherits its
+ * priority. Should a holder die with the lock, the next one to take it
+ * recovers it.
+ *
+ * Next to the mutex the segment tells who holds the port since when, and
+ * keeps counters of the waits and holds of everyone using it.
+ */
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#define PORTLOCK_SHM    "/irlp-lock-"
+#define PORTLOCK_MAGIC  0x4b434f4c  /* "LOCK" */
+#define PORTLOCK_VERSION 1
+
+struct portlock {
+    uint32_t    magic;          /* Set once the mutex is ready */
+    uint32_t    version;
+    pthread_mutex_t mutex;
+    pid_t       holder;         /* Holding process, 0 when free */
+    char        comm[16];       /* and its name */
+    uint64_t    since;          /* Monotonic us the hold started */
+    uint64_t    claims;         /* Times taken */
+    uint64_t    contended;      /* Times someone had to wait */
+    uint64_t    waitus;         /* Total and longest wait in us */
+    uint64_t    maxwaitus;
+    char        maxwaiter[16];  /* Who waited longest */
+    char        maxblocker[16]; /* and who held the port meanwhile */
+    uint64_t    holdus;         /* Total and longest hold in us */
+    uint64_t    maxholdus;
+    char        maxholder[16];
+    uint64_t    deaths;         /* Holders that died with the lock */
+    pid_t       lastdead;
+};
+
+struct portlock *portlock_open(const char *path);
+struct portlock *portlock_map(const char *path);
+int  portlock_take(struct portlock *l);
+void portlock_give(struct portlock *l);
@@ -29,19 +29,48 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <time.h>
+#include <errno.h>
+#include <signal.h>
 #include "irlpdev.h"
+#include "portctl_lib.h"
+#include "stats.h"
+#include "config.h"
+#include "sampler.h"
 #include "repeater.h"
 
 static char *usage =
     "Usage: portread CMD\n"
     "Read IRLP port state.\n"
+    "   -p      port DEVICE[,SETTING=VALUE,...]\n"
     "   -b      binary representation\n"
+    "   -d      read the port directly even if the repeater serves it\n"
+    "   -c      capture to a value change dump FILE and exit\n"
+    "   -s      capture sample rate in Hz, default %d\n"
+    "   -t      capture duration in seconds, default %d\n"
     "   -h      display this help and exit\n"
     "Copyright (c) 2013, Adi Linden <adi@adis.ca>\n";
 
+/* Capture defaults and limits */
+#define CAPRATE     20000
+#define CAPTIME     10
+#define CAPMAXRATE  50000
+#define CAPMAXLEN   (CAPMAXRATE * 60)
+
+/* A single capture sample */
+struct capsample {
+    uint64_t    t;              /* Time since start in ns */
+    uint64_t    late;           /* Time past its deadline in ns */
+    unsigned char c[2];         /* Status and data register */
+};
+
+int watch_shared(struct stats *st, int idx, int binary);
+int capture(struct port *port, char *file, int rate, int secs);
+void write_vcd(FILE *f, struct capsample *cs, int n);
 void print_irlp(unsigned char *c);
 void print_byte(unsigned char *c);
 void each_byte(unsigned char b);
@@ -51,36 +80,102 @@ int main(int argc, char *argv[])
     unsigned char c[2];          /* Returned string from parallel port */
     unsigned char s[2];          /* Saved string from parallel port */
     int binary = 0;              /* Flag for binary representation */
+    int direct = 0;              /* Flag to always read the port */
+    struct stats *st;            /* Published state of the repeater */
+    int i;
     struct timespec tim;         /* Timespec for the loop timer function */
+    struct sampler smp;          /* Paces the loop */
+    int ms;
+    struct port port;            /* The port we watch */
+    char *capfile = NULL;        /* Capture file */
+    int caprate = CAPRATE;       /* Capture sample rate */
+    int captime = CAPTIME;       /* Capture duration */
+
+    port_init(&port, IRLPDEV_PATH);
 
     /* Get any optional command line args (start with -) */
     while (argc > 1 && *argv[1] == '-') {
         if (!strcmp(argv[1], "-b")) {
             binary = 1;
         }
+        if (!strcmp(argv[1], "-d")) {
+            direct = 1;
+        }
         if (!strcmp(argv[1], "-h")) {
-            fprintf(stderr, usage);
+            fprintf(stderr, usage, CAPRATE, CAPTIME);
             return -1;
         }
+        if (!strcmp(argv[1], "-c") && argc > 2) {
+            capfile = argv[2];
+            argc -= 1;
+            argv += 1;
+        }
+        if (!strcmp(argv[1], "-s") && argc > 2) {
+            caprate = atoi(argv[2]);
+            argc -= 1;
+            argv += 1;
+        }
+        if (!strcmp(argv[1], "-t") && argc > 2) {
+            captime = atoi(argv[2]);
+            argc -= 1;
+            argv += 1;
+        }
+        if (!strcmp(argv[1], "-p") && argc > 2) {
+            if (port_config(&port, argv[2]) < 0) {
+                fprintf(stderr, "Invalid port %s\n", argv[2]);
+                return -1;
+            }
+            argc -= 1;
+            argv += 1;
+        }
         argc -= 1;
         argv += 1;
     }
 
+    /* Capture mode reads the port itself, claimed for the whole capture */
+    if (capfile != NULL) {
+        if (caprate < 1 || caprate > CAPMAXRATE) {
+            fprintf(stderr, "Support 1 to %d Hz sample rate\n", CAPMAXRATE);
+            return -1;
+        }
+        if (captime < 1 || (long)caprate * captime > CAPMAXLEN) {
+            fprintf(stderr, "Support up to %d samples per capture\n",
+                    CAPMAXLEN);
+            return -1;
+        }
+        return capture(&port, capfile, caprate, captime);
+    }
+
+    /* A running repeater publishes every port sample it takes, we follow
+     * that rather than competing for the port
+     */
+    st = direct ? NULL : stats_map();
+    if (st != NULL && kill(st->pid, 0) == 0) {
+        for (i = 0; i < st->nports && i < STATPORTS; ++i) {
+            if (!strcmp(st->port[i].name, port.name)) {
+                watch_shared(st, i, binary);
+                break;
+            }
+        }
+    }
+
     /* Opens the /dev/irlp-port device, read/write. This is the communication
      * Channel to the IRLP hardware from the software 
      */
-    if(irlpdev_open() < 0 ) {
+    if(irlpdev_open(&port.dev) < 0 ) {
         fprintf(stderr, "Can't access parallel port");
         return(-1);
     }
 
     /* Sets default settings for the main variables */
-    tim.tv_sec = 0;
-    tim.tv_nsec = 5000000;
+    sampler_init(&smp, FASTPOLL, IDLEPOLL, POLLDECAY, NULL);
 
     while (1) {
+        clock_gettime(CLOCK_MONOTONIC, &tim);
+        sampler_wake(&smp, tim.tv_sec * 1000.0 + tim.tv_nsec / 1e6);
+
         /* Reads the input and output bit from the port */
-        if (read_irlpdev(c, 2) != 2)
+        if (port_read(&port, c) != 2)
             fprintf(stderr, "Can't read parallel port");
 
         /* Compare with saved state */
@@ -92,7 +187,11 @@ int main(int argc, char *argv[])
             memcpy(s, c, 2);
         }
 
-        /* Pace our processing */
+        /* Pace our processing, fast while COS or the IRLP key is up */
+        ms = sampler_next(&smp, smp.last, (c[0] & port.pins.cos) ||
+                          (c[1] & port.pins.irlpkey), -1);
+        tim.tv_sec = ms / 1000;
+        tim.tv_nsec = (ms % 1000) * 1000000L;
         nanosleep(&tim, NULL);
     }
 
@@ -100,6 +199,169 @@ int main(int argc, char *argv[])
 }
 
 
+/* Nanoseconds of a monotonic clock reading */
+static inline uint64_t ns(struct timespec *ts)
+{
+    return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+/*
+ * Sample the port at a fixed rate into a preallocated buffer, holding the
+ * claim throughout, then write it out as a value change dump. Each sample
+ * has an absolute deadline, we spin until it is due.
+ */
+int capture(struct port *port, char *file, int rate, int secs)
+{
+    struct capsample *cs;
+    struct timespec ts;
+    uint64_t t0, due, now, period;
+    uint64_t late, maxlate = 0;
+    double sum = 0, achieved;
+    FILE *f;
+    int i, n;
+
+    n = rate * secs;
+    period = 1000000000ULL / rate;
+    cs = malloc(sizeof(*cs) * n);
+    if (cs == NULL) {
+        fprintf(stderr, "Can't allocate %d samples\n", n);
+        return -1;
+    }
+    memset(cs, 0, sizeof(*cs) * n);     /* Fault the pages in up front */
+
+    f = fopen(file, "w");
+    if (f == NULL) {
+        fprintf(stderr, "Can't open %s\n", file);
+        return -1;
+    }
+
+    if (irlpdev_open(&port->dev) < 0 || ppclaim(&port->dev) < 0) {
+        fprintf(stderr, "Can't access parallel port");
+        return -1;
+    }
+    fprintf(stderr, "Capturing %d samples at %d Hz from %s ...\n",
+            n, rate, port->dev.path);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    t0 = ns(&ts);
+    for (i = 0; i < n; ++i) {
+        due = t0 + period * i;
+        do {
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            now = ns(&ts);
+        } while (now < due);
+
+        if (sample_irlpdev(&port->dev, cs[i].c) < 0) {
+            fprintf(stderr, "Can't read parallel port\n");
+            n = i;
+            break;
+        }
+        cs[i].t = now - t0;
+        cs[i].late = now - due;
+    }
+    pprelease(&port->dev);
+
+    /* How well did we keep up */
+    for (i = 0; i < n; ++i) {
+        late = cs[i].late;
+        sum += late;
+        if (late > maxlate)
+            maxlate = late;
+    }
+    if (n > 1) {
+        achieved = (n - 1) * 1e9 / (cs[n - 1].t - cs[0].t);
+        fprintf(stderr, "Achieved %.1f Hz, jitter mean %.2f us, "
+                "max %.2f us\n", achieved, sum / n / 1e3, maxlate / 1e3);
+    }
+
+    write_vcd(f, cs, n);
+    fclose(f);
+    free(cs);
+    return 0;
+}
+
+/*
+ * Write samples as a value change dump with one signal per pin
+ */
+void write_vcd(FILE *f, struct capsample *cs, int n)
+{
+    static const char *names[2][8] = {
+        { "s0", "s1", "s2", "dtmf_q1", "dtmf_q2", "dtmf_q3", "dtmf_q4",
+          "cos" },
+        { "d0", "irlpkey", "key", "mute", "ctcss", "fan", "aux5", "d7" } };
+    static const char *regs[2] = { "status", "data" };
+    unsigned char last[2];
+    time_t now = time(NULL);
+    int i, r, b, changed;
+
+    fprintf(f, "$date %s$end\n", ctime(&now));
+    fprintf(f, "$version portread " VERSION " $end\n");
+    fprintf(f, "$timescale 1ns $end\n");
+    fprintf(f, "$scope module irlp $end\n");
+    for (r = 0; r < 2; ++r) {
+        fprintf(f, "$scope module %s $end\n", regs[r]);
+        for (b = 0; b < 8; ++b)
+            fprintf(f, "$var wire 1 %c %s $end\n", '!' + r * 8 + b,
+                    names[r][b]);
+        fprintf(f, "$upscope $end\n");
+    }
+    fprintf(f, "$upscope $end\n$enddefinitions $end\n");
+    if (n < 1)
+        return;
+
+    fprintf(f, "#%llu\n$dumpvars\n", (unsigned long long)cs[0].t);
+    for (r = 0; r < 2; ++r)
+        for (b = 0; b < 8; ++b)
+            fprintf(f, "%d%c\n", (cs[0].c[r] >> b) & 1, '!' + r * 8 + b);
+    fprintf(f, "$end\n");
+    memcpy(last, cs[0].c, 2);
+
+    for (i = 1; i < n; ++i) {
+        changed = (cs[i].c[0] ^ last[0]) | ((cs[i].c[1] ^ last[1]) << 8);
+        if (!changed)
+            continue;
+        fprintf(f, "#%llu\n", (unsigned long long)cs[i].t);
+        for (r = 0; r < 2; ++r)
+            for (b = 0; b < 8; ++b)
+                if (changed & (1 << (r * 8 + b)))
+                    fprintf(f, "%d%c\n", (cs[i].c[r] >> b) & 1,
+                            '!' + r * 8 + b);
+        memcpy(last, cs[i].c, 2);
+    }
+    fprintf(f, "#%llu\n", (unsigned long long)cs[n - 1].t);
+}
+
+/*
+ * Print the samples the repeater publishes for a port. Sleeps on the futex
+ * until the sample changes, returns once the repeater is gone.
+ */
+int watch_shared(struct stats *st, int idx, int binary)
+{
+    struct portstate ps;
+    unsigned char c[2];
+    uint32_t seq;
+
+    seq = stats_state(st, idx, &ps);
+    while (1) {
+        c[0] = ps.status;
+        c[1] = ps.data;
+        if (binary)
+            print_byte(c);
+        else
+            print_irlp(c);
+
+        /* Wait for the next change, check on the repeater now and then */
+        while (stats_wait(st, idx, seq, 1000) < 0) {
+            if (kill(st->pid, 0) < 0 && errno == ESRCH) {
+                fprintf(stderr, "Repeater is gone, reading the port\n");
+                return -1;
+            }
+        }
+        seq = stats_state(st, idx, &ps);
+    }
+    return 0;
+}
+
 void print_irlp(unsigned char *c)
 {
     unsigned char dtmf0;
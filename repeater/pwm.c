@@ -0,0 +1,322 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "irlpdev.h"
+#include "portctl_lib.h"
+#include "stats.h"
+#include "log.h"
+#include "pwm.h"
+
+/* A port as the PWM thread sees it, with a handle of its own */
+struct pwmport {
+    struct irlpdev  dev;
+    int             id;
+    unsigned char   pin;
+    int             hz;
+    int             on;         /* Set by the loop */
+    int             duty;       /* Permille, set by the loop */
+    int             level;      /* Last written, -1 before the first */
+    int             high;       /* In the high part of the period */
+    uint64_t        start;      /* Of the period, ns */
+    uint64_t        next;       /* Next edge, ns */
+    int             want;       /* Other writers waiting for the port */
+    int             paused;     /* While the port is out of service */
+    struct pwmstats *st;
+};
+
+static struct pwmport *pwms[MAXPORTS];  /* By port id */
+static struct pwmport pwmports[MAXPORTS];
+static int npwms = 0;
+static pthread_mutex_t outlocks[MAXPORTS] = {  /* Taken for every write */
+    [0 ... MAXPORTS - 1] = PTHREAD_MUTEX_INITIALIZER
+};
+static pthread_t driver;
+static int running = 0;
+
+/* Nanoseconds of a monotonic clock */
+static uint64_t mono_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Open a second handle to a port with a PWM pin
+ */
+int pwm_add(struct port *p, struct pwmstats *st)
+{
+    struct pwmport *w;
+
+    if (!p->pwm.pin || npwms >= MAXPORTS || p->id >= MAXPORTS)
+        return -1;
+    w = &pwmports[npwms];
+    if (irlpdev_dup(&p->dev, &w->dev) < 0)
+        return -1;
+    w->dev.quiet = 1;
+    w->id = p->id;
+    w->pin = p->pwm.pin;
+    w->hz = p->pwm.hz;
+    w->on = 0;
+    w->duty = 0;
+    w->level = -1;
+    w->high = 0;
+    w->start = 0;
+    w->next = 0;
+    w->want = 0;
+    w->paused = 0;
+    w->st = st;
+    memset(st, 0, sizeof(*st));
+    st->hz = w->hz;
+    pwms[p->id] = w;
+    ++npwms;
+    return 0;
+}
+
+/* Turn the output on at a duty in permille, or off */
+void pwm_set(int id, int on, int duty)
+{
+    if (pwms[id] == NULL)
+        return;
+    __atomic_store_n(&pwms[id]->duty, duty, __ATOMIC_RELAXED);
+    __atomic_store_n(&pwms[id]->on, on, __ATOMIC_RELAXED);
+}
+
+/* Around every other write to a port, keeps the edges out */
+void pwm_begin(int id)
+{
+    struct pwmport *w = pwms[id];
+    uint64_t t, us;
+
+    if (w != NULL)
+        __atomic_add_fetch(&w->want, 1, __ATOMIC_ACQ_REL);
+    t = mono_ns();
+    pthread_mutex_lock(&outlocks[id]);
+    if (w == NULL)
+        return;
+    us = (mono_ns() - t) / 1000;
+    if (us > w->st->maxholdus)
+        w->st->maxholdus = us;
+}
+
+void pwm_end(int id)
+{
+    pthread_mutex_unlock(&outlocks[id]);
+    if (pwms[id] != NULL)
+        __atomic_sub_fetch(&pwms[id]->want, 1, __ATOMIC_ACQ_REL);
+}
+
+/* Account a KEY or MUTE write of the loop that took us from start to done */
+void pwm_keyed(int id, uint64_t us)
+{
+    struct pwmport *w = pwms[id];
+
+    if (w == NULL)
+        return;
+    w->st->keywrites++;
+    w->st->keyus += us;
+    if (us > w->st->maxkeyus)
+        w->st->maxkeyus = us;
+}
+
+/*
+ * Drop the pin and close the handle while the port is out of service, so
+ * the device can go
+ */
+void pwm_pause(int id)
+{
+    struct pwmport *w = pwms[id];
+    unsigned char c[2];
+
+    if (w == NULL || __atomic_load_n(&w->paused, __ATOMIC_ACQUIRE))
+        return;
+    pwm_begin(id);
+    __atomic_store_n(&w->paused, 1, __ATOMIC_RELEASE);
+    modify_irlpdev(&w->dev, 0, w->pin, c);
+    irlpdev_close(&w->dev);
+    pwm_end(id);
+}
+
+/*
+ * The port is back, open the handle again and start a new period
+ */
+void pwm_resume(struct port *p)
+{
+    struct pwmport *w = pwms[p->id];
+
+    if (w == NULL || !__atomic_load_n(&w->paused, __ATOMIC_ACQUIRE))
+        return;
+    pwm_begin(p->id);
+    if (irlpdev_redup(&p->dev, &w->dev) >= 0) {
+        w->level = -1;
+        w->high = 0;
+        w->next = 0;
+        __atomic_store_n(&w->paused, 0, __ATOMIC_RELEASE);
+    }
+    pwm_end(p->id);
+}
+
+/* Write a level if it changed, late by us */
+static void pwm_level(struct pwmport *w, int level, uint64_t us)
+{
+    unsigned char c[2];
+
+    if (level == w->level)
+        return;
+    pthread_mutex_lock(&outlocks[w->id]);
+    if (__atomic_load_n(&w->paused, __ATOMIC_ACQUIRE)) {
+        pthread_mutex_unlock(&outlocks[w->id]);
+        return;
+    }
+    if (modify_irlpdev(&w->dev, level ? w->pin : 0, level ? 0 : w->pin,
+                       c) == 2) {
+        w->level = level;
+        w->st->edges++;
+        w->st->lateus += us;
+        if (us > w->st->maxlateus)
+            w->st->maxlateus = us;
+        if (us > PWMLATE)
+            w->st->late++;
+    } else {
+        w->st->errors++;
+    }
+    pthread_mutex_unlock(&outlocks[w->id]);
+}
+
+/*
+ * Write the edge due at now and work out the next. A period starts where
+ * the last one ended, or at now after a stall.
+ */
+static void pwm_step(struct pwmport *w, uint64_t now)
+{
+    uint64_t period = 1000000000 / w->hz;
+    uint64_t late = w->next ? (now - w->next) / 1000 : 0;
+    int duty = __atomic_load_n(&w->duty, __ATOMIC_RELAXED);
+
+    if (!__atomic_load_n(&w->on, __ATOMIC_RELAXED))
+        duty = 0;
+
+    /* The end of the high part */
+    if (w->high) {
+        pwm_level(w, 0, late);
+        w->high = 0;
+        w->next = w->start + period;
+        return;
+    }
+
+    /* The start of a period */
+    w->start = w->next;
+    if (!w->start || now - w->start >= period)
+        w->start = now;
+    w->st->duty = duty;
+    if (duty <= 0 || duty >= 1000) {
+        pwm_level(w, duty >= 1000, late);
+        w->next = w->start + period;
+        return;
+    }
+    pwm_level(w, 1, late);
+    w->high = 1;
+    w->next = w->start + period * duty / 1000;
+}
+
+/*
+ * The PWM thread
+ */
+static void *pwm_drive(void *arg)
+{
+    struct pwmport *w;
+    struct timespec ts;
+    uint64_t now, next, due;
+    int i;
+
+    while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        now = mono_ns();
+        next = now + 100000000;
+        for (i = 0; i < npwms; ++i) {
+            w = &pwmports[i];
+            if (__atomic_load_n(&w->paused, __ATOMIC_ACQUIRE))
+                continue;
+            due = w->next;
+            if (now >= due) {
+                /* Another writer wants the port, it goes first */
+                if (__atomic_load_n(&w->want, __ATOMIC_ACQUIRE)) {
+                    w->st->deferred++;
+                    due = now + PWMDEFER * 1000;
+                } else {
+                    pwm_step(w, now);
+                    due = w->next;
+                }
+            }
+            if (due < next)
+                next = due;
+        }
+        ts.tv_sec = next / 1000000000;
+        ts.tv_nsec = next % 1000000000;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+    return NULL;
+}
+
+/*
+ * Start the thread, at a realtime priority if we may
+ */
+int pwm_start()
+{
+    struct sched_param sp;
+
+    if (!npwms)
+        return 0;
+    running = 1;
+    if (pthread_create(&driver, NULL, pwm_drive, NULL)) {
+        running = 0;
+        return -1;
+    }
+    sp.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    if (pthread_setschedparam(driver, SCHED_FIFO, &sp))
+        do_log("PWM: no realtime priority, expect more jitter");
+    return 0;
+}
+
+/*
+ * Stop the thread, the pins stay as they are
+ */
+void pwm_stop()
+{
+    if (!running)
+        return;
+    __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+    pthread_join(driver, NULL);
+}
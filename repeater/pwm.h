@@ -0,0 +1,60 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Software PWM
+ *
+ * A thread of its own drives the PWM pin of every port that has one. It
+ * sleeps to absolute deadlines on the monotonic clock, so late wakeups do
+ * not add up, and writes the port only when the level changes. At 0 or
+ * 100 percent duty the port is not written at all.
+ *
+ * The thread and every other writer of a port, the loop and the beacon,
+ * take turns through a mutex of the port. The other writers go first: an
+ * edge due while one of them wants the port is held back PWMDEFER, so a
+ * KEY or MUTE write waits at most for an edge already being written. At
+ * most PWMMAXHZ keeps the PWM to two port writes a period. The loop never
+ * writes the PWM pin itself, it only says whether the output is on and at
+ * which duty. How late each edge was, how long the other writes waited
+ * and how long the KEY and MUTE writes of the loop took are kept in the
+ * pwmstats of the port.
+ */
+
+#define PWMLATE     1000        /* An edge this many us late is counted */
+#define PWMDEFER    200         /* An edge held back for another write, us */
+
+int  pwm_add(struct port *p, struct pwmstats *st);
+void pwm_set(int id, int on, int duty);
+void pwm_begin(int id);
+void pwm_end(int id);
+void pwm_keyed(int id, uint64_t us);
+void pwm_pause(int id);
+void pwm_resume(struct port *p);
+int  pwm_start();
+void pwm_stop();
@@ -0,0 +1,245 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "recorder.h"
+
+static char *usage =
+    "Usage: recdump [OPTION]\n"
+    "Dump the repeater flight recorder.\n"
+    "   -f      recorder FILE, default " RECFILE "\n"
+    "   -t      only records of TYPE [boot|input|output|timer|start|exit]\n"
+    "   -p      only records of port number\n"
+    "   -c      export as comma separated values\n"
+    "   -h      display this help and exit\n"
+    "Copyright (c) 2026, Adi Linden <adi@adis.ca>\n";
+
+static char *types[REC_TYPES] =
+    { "", "boot", "input", "output", "timer", "start", "exit" };
+static char *timers[] =
+    { "", "fan", "mute", "shortkey", "ct", "idwait", "idperiod", "idreset",
+      "hang" };
+static char *scripts[] = { "", "courtesy", "ider", "announce" };
+
+int csv = 0;
+int onlytype = 0;
+int onlyport = -1;
+
+int cmpseq(const void *a, const void *b);
+void dump_block(struct recblk *b);
+void print_rec(uint64_t t, int type, unsigned int *f);
+
+int main(int argc, char *argv[])
+{
+    char *file = RECFILE;
+    struct rechdr *hdr;
+    struct recblk **blks;
+    struct stat st;
+    int fd, i, n;
+
+    /* Get any optional command line args (start with -) */
+    while (argc > 1 && *argv[1] == '-') {
+        if (!strcmp(argv[1], "-c")) {
+            csv = 1;
+        }
+        if (!strcmp(argv[1], "-h")) {
+            fprintf(stderr, usage);
+            return -1;
+        }
+        if (!strcmp(argv[1], "-f") && argc > 2) {
+            file = argv[2];
+            argc -= 1;
+            argv += 1;
+        }
+        if (!strcmp(argv[1], "-p") && argc > 2) {
+            onlyport = atoi(argv[2]);
+            argc -= 1;
+            argv += 1;
+        }
+        if (!strcmp(argv[1], "-t") && argc > 2) {
+            for (i = 1; i < REC_TYPES; ++i)
+                if (!strcmp(argv[2], types[i]))
+                    onlytype = i;
+            if (!onlytype) {
+                fprintf(stderr, "Unknown record type %s\n", argv[2]);
+                return -1;
+            }
+            argc -= 1;
+            argv += 1;
+        }
+        argc -= 1;
+        argv += 1;
+    }
+
+    /* Map the recording read only, the controller may be writing it */
+    fd = open(file, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0 || st.st_size < RECBLK) {
+        fprintf(stderr, "Can't open recorder %s\n", file);
+        return -1;
+    }
+    hdr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (hdr == MAP_FAILED) {
+        fprintf(stderr, "Can't map recorder %s\n", file);
+        return -1;
+    }
+    if (hdr->magic != RECMAGIC || hdr->version != RECVERSION ||
+            hdr->blksz != RECBLK ||
+            st.st_size < (off_t)RECBLK * (hdr->nblocks + 1)) {
+        fprintf(stderr, "%s is not a flight recorder file\n", file);
+        return -1;
+    }
+
+    /* Collect the valid blocks oldest first */
+    blks = malloc(sizeof(*blks) * hdr->nblocks);
+    if (blks == NULL)
+        return -1;
+    for (i = 0, n = 0; i < hdr->nblocks; ++i) {
+        blks[n] = (struct recblk *)((char *)hdr + RECBLK * (i + 1));
+        if (blks[n]->seq)
+            ++n;
+    }
+    qsort(blks, n, sizeof(*blks), cmpseq);
+
+    if (csv)
+        printf("time,type,port,a,b,c\n");
+    for (i = 0; i < n; ++i)
+        dump_block(blks[i]);
+
+    free(blks);
+    return 0;
+}
+
+int cmpseq(const void *a, const void *b)
+{
+    uint32_t x = (*(struct recblk **)a)->seq;
+    uint32_t y = (*(struct recblk **)b)->seq;
+
+    return (x > y) - (x < y);
+}
+
+/* Read an unsigned varint, NULL if it runs past the end */
+unsigned char *get_varint(unsigned char *p, unsigned char *e, uint64_t *v)
+{
+    int shift = 0;
+
+    *v = 0;
+    while (p < e && shift < 64) {
+        *v |= (uint64_t)(*p & 0x7f) << shift;
+        if (!(*p++ & 0x80))
+            return p;
+        shift += 7;
+    }
+    return NULL;
+}
+
+void dump_block(struct recblk *b)
+{
+    unsigned char *p = b->data;
+    unsigned char *e = b->data + b->used;
+    unsigned int f[3];
+    uint64_t t = b->t0;
+    uint64_t v;
+    int type, i, n;
+
+    if (b->used > sizeof(b->data))
+        return;
+
+    while (p < e) {
+        type = *p++;
+        n = rec_fields(type);
+        if (n < 0)
+            return;
+        if ((p = get_varint(p, e, &v)) == NULL)
+            return;
+        t += (int64_t)(v >> 1) ^ -(int64_t)(v & 1);     /* zigzag */
+        f[0] = f[1] = f[2] = 0;
+        for (i = 0; i < n; ++i) {
+            if ((p = get_varint(p, e, &v)) == NULL)
+                return;
+            f[i] = v;
+        }
+        print_rec(t, type, f);
+    }
+}
+
+void print_rec(uint64_t t, int type, unsigned int *f)
+{
+    char ts[40];
+    time_t sec = t / 1000000;
+    int port = (type == REC_BOOT) ? -1 : (int)f[0];
+
+    if (onlytype && type != onlytype)
+        return;
+    if (onlyport >= 0 && port != onlyport)
+        return;
+
+    if (csv) {
+        printf("%llu.%06llu,%s,%d,%u,%u,%u\n",
+               (unsigned long long)(t / 1000000),
+               (unsigned long long)(t % 1000000),
+               types[type], port, f[0], f[1], f[2]);
+        return;
+    }
+
+    strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", localtime(&sec));
+    printf("%s.%06llu ", ts, (unsigned long long)(t % 1000000));
+    switch (type) {
+        case REC_BOOT:
+            printf("boot   pid %u\n", f[0]);
+            break;
+        case REC_INPUT:
+            printf("input  port %u status 0x%02x data 0x%02x\n",
+                   f[0], f[1], f[2]);
+            break;
+        case REC_OUTPUT:
+            printf("output port %u data 0x%02x -> 0x%02x\n", f[0], f[1], f[2]);
+            break;
+        case REC_TIMER:
+            printf("timer  port %u %s\n", f[0],
+                   f[1] < sizeof(timers) / sizeof(*timers) ? timers[f[1]] : "?");
+            break;
+        case REC_START:
+            printf("start  port %u %s pid %u\n", f[0],
+                   f[1] < sizeof(scripts) / sizeof(*scripts) ? scripts[f[1]] : "?",
+                   f[2]);
+            break;
+        case REC_EXIT:
+            printf("exit   port %u pid %u status %u\n", f[0], f[1], f[2]);
+            break;
+    }
+}
@@ -0,0 +1,178 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include "recorder.h"
+
+static struct rechdr *hdr = NULL;   /* Mapped file, NULL when off */
+static struct recblk *blk = NULL;   /* Block being filled */
+static uint64_t now = 0;            /* Time of the events recorded next */
+static uint64_t last = 0;           /* Time of the last record in blk */
+
+/* Number of fields of each record type */
+static const int fields[REC_TYPES] = { 0, 1, 3, 3, 2, 3, 3 };
+
+int rec_fields(int type)
+{
+    if (type < 1 || type >= REC_TYPES)
+        return -1;
+    return fields[type];
+}
+
+/*
+ * Start a fresh block in the ring. The sequence is published last so a
+ * reader never trusts a half set up block.
+ */
+static void rec_next()
+{
+    uint32_t i;
+
+    if (blk != NULL)
+        msync(blk, RECBLK, MS_ASYNC);
+
+    i = (hdr->cur + 1) % hdr->nblocks;
+    blk = (struct recblk *)((char *)hdr + RECBLK * (i + 1));
+    __atomic_store_n(&blk->seq, 0, __ATOMIC_RELEASE);
+    blk->used = 0;
+    blk->t0 = now;
+    last = now;
+    hdr->cur = i;
+    __atomic_store_n(&blk->seq, ++hdr->seq, __ATOMIC_RELEASE);
+}
+
+/*
+ * Map the recorder file, creating it if needed. An existing recording is
+ * continued so what led up to a crash stays available.
+ */
+int rec_open(char *path)
+{
+    int fd;
+    size_t sz = (size_t)RECBLK * (RECBLOCKS + 1);
+
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Can't open recorder %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, sz) < 0) {
+        fprintf(stderr, "Can't size recorder %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    hdr = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (hdr == MAP_FAILED) {
+        fprintf(stderr, "Can't map recorder %s: %s\n", path, strerror(errno));
+        hdr = NULL;
+        return -1;
+    }
+
+    if (hdr->magic != RECMAGIC || hdr->version != RECVERSION ||
+            hdr->blksz != RECBLK || hdr->nblocks != RECBLOCKS ||
+            hdr->cur >= RECBLOCKS) {
+        memset(hdr, 0, sz);
+        hdr->magic = RECMAGIC;
+        hdr->version = RECVERSION;
+        hdr->blksz = RECBLK;
+        hdr->nblocks = RECBLOCKS;
+        hdr->cur = RECBLOCKS - 1;
+    }
+    blk = NULL;
+    rec_next();
+    rec_put(REC_BOOT, getpid(), 0, 0);
+    return 0;
+}
+
+/*
+ * Set the time of the events that follow, typically once per loop pass
+ */
+void rec_time(uint64_t us)
+{
+    now = us;
+}
+
+/* Append an unsigned varint */
+static inline unsigned char *rec_varint(unsigned char *p, uint64_t v)
+{
+    while (v >= 0x80) {
+        *p++ = v | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+/*
+ * Append a record, this is a handful of stores into the mapping
+ */
+void rec_put(int type, unsigned int a, unsigned int b, unsigned int c)
+{
+    unsigned char *p, *s;
+    int64_t d;
+    int n;
+
+    if (hdr == NULL || type < 1 || type >= REC_TYPES)
+        return;
+    if (blk->used > sizeof(blk->data) - RECMAX)
+        rec_next();
+
+    s = p = blk->data + blk->used;
+    d = (int64_t)(now - last);
+    last = now;
+
+    *p++ = type;
+    p = rec_varint(p, (uint64_t)((d << 1) ^ (d >> 63)));    /* zigzag */
+    n = fields[type];
+    if (n > 0)
+        p = rec_varint(p, a);
+    if (n > 1)
+        p = rec_varint(p, b);
+    if (n > 2)
+        p = rec_varint(p, c);
+
+    __atomic_store_n(&blk->used, blk->used + (p - s), __ATOMIC_RELEASE);
+}
+
+/*
+ * Push the recording towards the disk and unmap it
+ */
+void rec_close()
+{
+    if (hdr == NULL)
+        return;
+    msync(hdr, (size_t)RECBLK * (RECBLOCKS + 1), MS_SYNC);
+    munmap(hdr, (size_t)RECBLK * (RECBLOCKS + 1));
+    hdr = NULL;
+    blk = NULL;
+}
@@ -0,0 +1,93 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Flight recorder
+ *
+ * A fixed size file mapped into memory and used as a ring of blocks. Each
+ * block starts with a sequence number and a base time, the records in it
+ * carry a time delta to the record before and their fields as varints.
+ * Records never span blocks, so a block overwritten while the controller
+ * died only loses that block. Only the control thread records.
+ */
+
+#include <stdint.h>
+
+#define RECFILE     "/var/tmp/repeater.rec"
+#define RECMAGIC    0x43455250  /* "PREC" */
+#define RECVERSION  1
+#define RECBLK      4096        /* Block size in bytes */
+#define RECBLOCKS   256         /* Blocks in the ring */
+#define RECMAX      48          /* Max encoded record size */
+
+/* Record types and their fields */
+#define REC_BOOT    1           /* Controller start: pid */
+#define REC_INPUT   2           /* Input edge: port, status, data */
+#define REC_OUTPUT  3           /* Output change: port, old, new data */
+#define REC_TIMER   4           /* Timer expiry: port, timer */
+#define REC_START   5           /* Script start: port, script, pid */
+#define REC_EXIT    6           /* Script exit: port, pid, status */
+#define REC_TYPES   7
+
+/* Timers */
+#define RT_FAN      1           /* FANDELAY */
+#define RT_MUTE     2           /* MUTETIME */
+#define RT_SHORTKEY 3           /* SHORTKEY */
+#define RT_CT       4           /* CTTIME, CTTIMEI */
+#define RT_IDWAIT   5           /* IDWAIT */
+#define RT_IDPERIOD 6           /* IDPERIOD */
+#define RT_IDRESET  7           /* IDPERIOD + IDWAIT */
+#define RT_HANG     8           /* HANGTIME */
+
+/* Scripts */
+#define RS_CT       1
+#define RS_ID       2
+#define RS_AN       3
+
+struct rechdr {
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    blksz;
+    uint32_t    nblocks;
+    uint32_t    seq;            /* Sequence of the newest block */
+    uint32_t    cur;            /* Index of the newest block */
+};
+
+struct recblk {
+    uint32_t    seq;            /* 0 while the block is set up */
+    uint32_t    used;           /* Bytes of records in data */
+    uint64_t    t0;             /* Base time in us since the epoch */
+    unsigned char data[RECBLK - 16];
+};
+
+int  rec_open(char *path);
+void rec_time(uint64_t us);
+void rec_put(int type, unsigned int a, unsigned int b, unsigned int c);
+void rec_close();
+int  rec_fields(int type);
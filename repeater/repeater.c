@@ -31,141 +31,583 @@
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <signal.h>
+#include <errno.h>
 #include <unistd.h>
 #include <sys/types.h>      /* waitpid() child handling */
 #include <sys/wait.h>       /* waitpid() child handling */
 #include <sys/time.h>
-#include "portctl_lib.h"
+#include <sys/signalfd.h>
+#include <poll.h>
 #include "irlpdev.h"
+#include "portctl_lib.h"
 #include "log.h"
+#include "recorder.h"
+#include "stats.h"
+#include "control.h"
+#include "config.h"
+#include "supervise.h"
+#include "watchdog.h"
+#include "sampler.h"
+#include "state.h"
+#include "history.h"
+#include "health.h"
+#include "calendar.h"
+#include "pwm.h"
+#include "beacon.h"
+#include "probes.h"
 #include "repeater.h"
 
 /* Our program name */
 #define PROG        "repeater"
 
-/* Default timing values */
+/* Loop timing, the other timing values are in config.h */
 /* NOTE: all times are in millseconds */
-#define HANGTIME    3000
-#define SHORTKEY    10
-#define FANDELAY    300000
-#define MUTETIME    1000
-#define CTTIME      1000
-#define CTTIMEI     300
-#define IDPERIOD    1200000
-#define IDWAIT      480000
-#define IDKEYDLY    100
+#define LATETIME    5           /* A pass later than this is an overrun */
+#define CTLQUEUE    8           /* Control requests taken per pass */
+#define HANDOFFTRIES 60         /* Handoffs asked for while scripts play */
 
 /* External scripts */
 #define BEEP_SCRIPT "courtesy"
 #define IDER_SCRIPT "ider"
+#define ANNOUNCE_SCRIPT "announce"
+
+#define ANNQUEUE    4           /* Announcements waiting per port */
 
 static char *usage =
     "Usage: " PROG " [OPTION]\n"
     "The repeater controller.\n"
+    "   -p      port DEVICE[,SETTING=VALUE,...], repeat for up to %d ports\n"
+    "   -r      flight recorder FILE or `none', default " RECFILE "\n"
+    "   -S      state FILE or `none', default " STATEFILE "\n"
+    "   -H      usage history FILE or `none', default " HISTFILE "\n"
+    "   -a      announcement schedule FILE, default " CALFILE "\n"
+    "   -f      configuration FILE, default " CONFFILE "\n"
+    "   -c      control socket PATH or `none', default " CTLSOCK "\n"
+    "   -s      run under a supervisor that restarts the controller\n"
+    "   -P      pid FILE, default " PIDFILE "\n"
+    "   -u      take over from the running controller, if there is one\n"
     "   -l      log to syslog\n"
     "   -v      clutter the screen\n"
     "   -h      display this help and exit\n"
     "Copyright (c) 2013, Adi Linden <adi@adis.ca>\n";
 
+/* State of one repeater, all repeaters are serviced by the same loop */
+struct rpt {
+    struct port port;            /* Device, pin map and sound device */
+    unsigned char in[2];         /* Inputs seen last pass, for edges */
+    struct portstats *st;        /* Our live counters */
+    double last;                 /* Time of the previous pass */
+    unsigned char set;           /* Output bits to set this pass */
+    unsigned char clr;           /* Output bits to clear this pass */
+
+    pid_t ctpid;                 /* Keep track of spawned courtesy script */
+    pid_t idpid;                 /* Kepp track of spawned ider script */
+    pid_t anpid;                 /* And of the announce script */
+
+    int idstate;                 /* Determines state of ID */
+    int ctbusy;                  /* Flag while courtesy script executing */
+    int idbusy;                  /* Flag while id script executing */
+    int anbusy;                  /* Flag while announce script executing */
+    int ctflag;                  /* Flag when the courtesy tone has played */
+    int idflag;                  /* Flag when the ID tone has played */
+    int muteflag;                /* Flag when the muter is on */
+    int keyflag;                 /* Flag when the system (AUX1) is keyed */
+    int shortkeyflag;            /* Flag when the shortkey feature is active */
+    int forcekeyflag;            /* Flag when the forcekey feature is active */
+    int fanflag;                 /* Flag when the fan is active */
+    int irlpflag;                /* Flag when IRLP keyed and is active */
+    int ctlkeyflag;              /* Flag when keyed through the socket */
+    int ctlmuteflag;             /* Flag when muted through the socket */
+    int pwmflag;                 /* Flag when the PWM output is on */
+    double txduty;               /* Recent transmitter duty cycle, 0-1 */
+
+    double mutetimer;            /* Definition of the timer to measure time 
+                                    bewteen mute on and mute off */
+    double hangtimer;            /* Definition of the timer to measure time 
+                                    bewteen start of key and unkey */
+    double cttimer;              /* Definition of the timer to measure time 
+                                    bewteen unkey and the playing of the 
+                                    courtesy tone */
+    double idtimer;              /* Definition of the timer to measure time
+                                    between keyup and the playing of the ID */
+    double shortkeytimer;        /* Definition of the timer to measure time 
+                                    bewteen mute on and mute off */
+    double fantimer;             /* Definition of the time to measure time
+                                    from transmit drop to fan off */
+    double ctstart;              /* When the scripts were started */
+    double idstart;
+    double anstart;
+    double exitat;               /* When a script exited, until unkey */
+    struct scriptstats *exited;  /* And which one */
+    struct portstats hist;       /* Counters already in the history */
+    struct health health;        /* Failures, outage and reopen backoff */
+    int nanq;                    /* Announcements waiting for the channel */
+    char anq[ANNQUEUE][CALMSG];
+};
+
+static struct rpt rpts[MAXPORTS];
+static int nrpts = 0;
+static struct stats *stats;            /* Our counters, in our memory */
+static struct stats counters;
+static struct stats *shared;           /* Where they are published */
+static struct rptconf conf;
+static struct sampler sampler;  /* Paces the loop */
+static struct calendar cal;     /* Announcements by time of day */
+static volatile sig_atomic_t reload = 0;
+static volatile sig_atomic_t quit = 0;
+
+/* Scripts reaped but not yet handled by their port */
+static struct {
+    pid_t   pid;
+    int     status;
+    double  at;                 /* When it was reaped */
+} exits[MAXPORTS * 3];
+static int nexits = 0;
+
+/* What a controller hands to the one taking over from it. The pidfile,
+ * the control socket and the device of each port in this order are
+ * passed along with it.
+ */
+struct handoff {
+    struct statesave save;
+};
+
+/* Commands the control socket takes, besides the pin commands */
+static char *ctlcmds[] = {
+    "status", "key", "keyup", "unkey", "mute", "unmute", "fanon", "fanoff",
+    "ctcsson", "ctcssoff", "aux4on", "aux4off", "aux5on", "aux5off",
+    "ct", "id", NULL
+};
+
+/* Log with the name of the port prefixed, str must be static */
+void rpt_log(struct rpt *r, char *str)
+{
+    log_event(EV_PORT, r->port.name, str, 0);
+}
+
+/* Timing source */
+double dnow()
+{
+    struct timeval tv;
+    if( gettimeofday(&tv, NULL) < 0 ) return (0);
+    else return(1000*((double)tv.tv_sec + 1.e-6 * (double)tv.tv_usec));
+}
+
+/* Put the outputs of a port in their safe state, the state repeater_init
+ * leaves them in. A beacon running here is paused and keys up through
+ * its own handle, so its pin is left out of the write.
+ */
+void rpt_safe(struct rpt *r)
+{
+    static char *safe[] = { "unkey", "mute", "fanoff", "aux5off", "ctcsson",
+                            NULL };
+    unsigned char set = 0, clr = 0;
+    char **c;
+
+    for (c = safe; *c != NULL; ++c)
+        port_command(&r->port, *c, &set, &clr);
+    r->pwmflag = 0;
+    pwm_set(r->port.id, 0, 0);
+    if (beacon_pause(r->port.id) == 0) {
+        set &= ~r->port.beacon.pin;
+        clr &= ~r->port.beacon.pin;
+    }
+    pwm_begin(r->port.id);
+    portctl_masks(&r->port, set, clr, "safe");
+    pwm_end(r->port.id);
+}
+
+/* The port went out of service. Its outputs are put safe if the device
+ * still takes a write, and whatever kept the transmitter up is forgotten
+ * so it comes back unkeyed. The PWM, beacon and watchdog let go of their
+ * handles too, a GPIO line request can't be taken again while one holds
+ * it, and they open them again once the port is back.
+ */
+void rpt_down(struct rpt *r)
+{
+    rpt_safe(r);                /* Pauses the beacon */
+    pwm_pause(r->port.id);
+    wd_pause(r->port.id);
+    irlpdev_close(&r->port.dev);
+    if (r->ctpid)
+        kill(-r->ctpid, SIGTERM);
+    if (r->idpid)
+        kill(-r->idpid, SIGTERM);
+    if (r->anpid)
+        kill(-r->anpid, SIGTERM);
+    r->ctbusy = 0;
+    r->idbusy = 0;
+    r->anbusy = 0;
+    r->set = 0;
+    r->clr = 0;
+    r->keyflag = OFF;
+    r->muteflag = ON;
+    r->fanflag = OFF;
+    r->irlpflag = 0;
+    r->shortkeyflag = 0;
+    r->forcekeyflag = 0;
+    r->ctlkeyflag = 0;
+    r->ctlmuteflag = 0;
+    r->ctflag = 1;
+    r->in[0] = 0;
+    r->in[1] = 0;
+}
+
+/* Queue an output change, all changes of a pass are written at once.
+ * Returns ret so callers can track the state like with the pin functions.
+ */
+int rpt_out(struct rpt *r, char *cmd, int ret)
+{
+    log_event(EV_DOING, r->port.name, cmd, 0);
+    port_command(&r->port, cmd, &r->set, &r->clr);
+    return ret;
+}
+
+/* Write the output changes of this pass in a single port transaction.
+ * Changes that did not make it are tried again with the next pass.
+ */
+void rpt_flush(struct rpt *r, double now)
+{
+    unsigned char pwm = r->port.pwm.pin;
+    unsigned char beacon = r->port.beacon.pin;
+    double t;
+    int k;
+
+    /* The PWM pin is driven by its thread, we only turn it on and off */
+    if (r->set & pwm)
+        r->pwmflag = 1;
+    if (r->clr & pwm)
+        r->pwmflag = 0;
+    r->set &= ~pwm;
+    r->clr &= ~pwm;
+
+    /* The beacon pin belongs to its thread altogether */
+    r->set &= ~beacon;
+    r->clr &= ~beacon;
+
+    if (!r->set && !r->clr)
+        return;
+    t = dnow();
+    pwm_begin(r->port.id);
+    k = portctl_masks(&r->port, r->set, r->clr, NULL);
+    pwm_end(r->port.id);
+    if (k >= 0 && ((r->set | r->clr) & (r->port.pins.key |
+                                        r->port.pins.mute)))
+        pwm_keyed(r->port.id, (dnow() - t) * 1000);
+    if (k < 0) {
+        if (health_fail(&r->health, now, r->port.name, &r->port.dev))
+            rpt_down(r);
+        return;
+    }
+    r->set = 0;
+    r->clr = 0;
+}
+
+/* Find a script in the PATH like the shell would */
+static void script_path(const char *script, char *path, int sz)
+{
+    const char *dir, *end;
+    char *env = getenv("PATH");
 
-/* Execute external script in a non-blocking fashion */
-void fork_script(pid_t *pid, const char *script)
+    snprintf(path, sz, "%s", script);
+    if (strchr(script, '/') != NULL || env == NULL)
+        return;
+    for (dir = env; ; dir = end + 1) {
+        end = strchr(dir, ':');
+        if (end == NULL)
+            end = dir + strlen(dir);
+        snprintf(path, sz, "%.*s%s%s", (int)(end - dir), dir,
+                 end > dir ? "/" : "", script);
+        if (!access(path, X_OK) || *end == '\0')
+            return;
+    }
+}
+
+/* Execute external script in a non-blocking fashion. The script learns
+ * about the port it runs for through the environment.
+ *
+ * Our threads may hold the malloc or environment locks when we fork, so
+ * the path and the environment are made up front and the child does no
+ * more than exec the script. The child waits IDKEYDLY before the script,
+ * the wait after it is taken by check_script().
+ */
+void fork_script(struct rpt *r, pid_t *pid, const char *script,
+                 const char *msg)
 {
+    extern char **environ;
+    char path[256], port[64], sound[64], ann[CALMSG + 16];
+    char *argv[2], **envp;
+    struct timespec dly;
+    sigset_t chld;
+    int i, n;
+
+    script_path(script, path, sizeof(path));
+    for (n = 0; environ[n] != NULL; ++n)
+        ;
+    envp = malloc((n + 4) * sizeof(char *));
+    if (envp == NULL)
+        exit(-1);
+    for (i = n = 0; environ[i] != NULL; ++i)
+        if (strncmp(environ[i], "RPT_", 4))
+            envp[n++] = environ[i];
+    snprintf(port, sizeof(port), "RPT_PORT=%s", r->port.name);
+    envp[n++] = port;
+    if (r->port.sound[0]) {
+        snprintf(sound, sizeof(sound), "RPT_SOUND=%s", r->port.sound);
+        envp[n++] = sound;
+    }
+    if (msg != NULL) {
+        snprintf(ann, sizeof(ann), "RPT_ANNOUNCE=%s", msg);
+        envp[n++] = ann;
+    }
+    envp[n] = NULL;
+    argv[0] = path;
+    argv[1] = NULL;
+    dly.tv_sec = conf.idkeydly / 1000;
+    dly.tv_nsec = (conf.idkeydly % 1000) * 1000000;
+
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
     *pid = fork();
     if (*pid == 0) {
-        usleep(IDKEYDLY * 1000);
-        system(script);
-        usleep(IDKEYDLY * 1000);
-        exit(0);
+        setpgid(0, 0);          /* So we can stop the whole script */
+        sigprocmask(SIG_UNBLOCK, &chld, NULL);
+        nanosleep(&dly, NULL);
+        execve(path, argv, envp);
+        _exit(127);
     }
+    free(envp);
     if (*pid < 0) {
         exit(-1);
     }
+    PROBE3(repeater, script_start, r->port.id, *pid, script);
 }
 
 /* Beep using external script */
-void do_ct(pid_t *pid)
+void do_ct(struct rpt *r)
 {
-    char m[30];
-
-    if (!*pid) {
-        fork_script(pid, BEEP_SCRIPT);
-        sprintf(m, "Script: [%d] " BEEP_SCRIPT, *pid);
-        do_log(m);
+    if (!r->ctpid) {
+        fork_script(r, &r->ctpid, BEEP_SCRIPT, NULL);
+        r->ctstart = dnow();
+        rec_put(REC_START, r->port.id, RS_CT, r->ctpid);
+        r->st->cts++;
+        log_event(EV_SCRIPT, r->port.name, BEEP_SCRIPT, r->ctpid);
     }
     else {
-        do_log("Failed: " BEEP_SCRIPT);
+        log_event(EV_FAILED, r->port.name, BEEP_SCRIPT, 0);
     }
 }
 
 /* Beep using external script */
-void do_id(pid_t *pid)
+void do_id(struct rpt *r)
 {
-    char m[30];
-
-    if (!*pid) {
-        fork_script(pid, IDER_SCRIPT);
-        sprintf(m, "Script: [%d] " IDER_SCRIPT, *pid);
-        do_log(m);
+    if (!r->idpid) {
+        fork_script(r, &r->idpid, IDER_SCRIPT, NULL);
+        r->idstart = dnow();
+        rec_put(REC_START, r->port.id, RS_ID, r->idpid);
+        r->st->ids++;
+        log_event(EV_SCRIPT, r->port.name, IDER_SCRIPT, r->idpid);
     }
     else {
-        do_log("Failed: " IDER_SCRIPT);
+        log_event(EV_FAILED, r->port.name, IDER_SCRIPT, 0);
     }
 }
 
-/* Handle forked scripts */
-void check_script(pid_t *pid)
+/* Play the oldest announcement waiting using external script */
+void do_announce(struct rpt *r)
+{
+    char buf[LOGTXT];
+
+    fork_script(r, &r->anpid, ANNOUNCE_SCRIPT, r->anq[0]);
+    r->anstart = dnow();
+    rec_put(REC_START, r->port.id, RS_AN, r->anpid);
+    r->st->anns++;
+    log_event(EV_SCRIPT, r->port.name, ANNOUNCE_SCRIPT, r->anpid);
+    snprintf(buf, sizeof(buf), "%s: Announce: %.48s", r->port.name,
+             r->anq[0]);
+    do_log(buf);
+    --r->nanq;
+    memmove(r->anq[0], r->anq[1], r->nanq * sizeof(r->anq[0]));
+}
+
+/* Queue an announcement that fell due, it plays when the channel allows */
+void rpt_announce(struct rpt *r, const char *msg)
+{
+    char buf[LOGTXT];
+
+    if (r->nanq == ANNQUEUE) {
+        snprintf(buf, sizeof(buf), "%s: Announce: queue full, dropped %.32s",
+                 r->port.name, msg);
+        do_log(buf);
+        return;
+    }
+    snprintf(r->anq[r->nanq++], sizeof(r->anq[0]), "%s", msg);
+}
+
+/* Account a script that exited */
+void script_exited(struct rpt *r, pid_t *pid, const char *script,
+                   struct scriptstats *ss, double start, int s, double now)
+{
+    char buf[LOGTXT];
+    uint64_t us;
+    int code;
+
+    us = (now - start) * 1000;
+    code = WIFEXITED(s) ? WEXITSTATUS(s) : -WTERMSIG(s);
+    rec_put(REC_EXIT, r->port.id, *pid, s);
+    PROBE4(repeater, script_exit, r->port.id, *pid, code, us);
+    ss->lastexit = code;
+    ss->lastus = us;
+    ss->totalus += us;
+    if (us > ss->maxus)
+        ss->maxus = us;
+    if (code)
+        ss->fails++;
+    snprintf(buf, sizeof(buf), "%s: Script: [%d] %s exited with %d after "
+             "%d ms", r->port.name, (int)*pid, script, code, (int)(us / 1000));
+    do_log(buf);
+
+    r->exitat = now;
+    r->exited = ss;
+    *pid = 0;
+}
+
+/* Reap every script that exited. With the signalfd this runs as soon as
+ * one does, otherwise once per pass. The exits are handed to the ports by
+ * check_script() at the point of the pass that used to poll for them.
+ */
+void reap_scripts()
 {
-    int s;
     pid_t p;
-    char m[30];
+    int s;
 
-    /* If pid is not 0 we have a child */
-    if (*pid) {
+    while (nexits < MAXPORTS * 3 && (p = waitpid(-1, &s, WNOHANG)) > 0) {
+        exits[nexits].pid = p;
+        exits[nexits].status = s;
+        exits[nexits].at = dnow();
+        ++nexits;
+    }
+}
 
-        /* 
-         * waitpid() returns the pid of the child that terminated 
-         * the pid is passed by reference, set it 0 to indicate
-         * no more child is present
-         */
-        p = waitpid(*pid, &s, WNOHANG);
-        if (p == *pid) {
-            sprintf(m, "Script: [%d] exited", *pid);
-            do_log(m);
-            *pid = 0;
+/* Handle forked scripts */
+void check_script(struct rpt *r, pid_t *pid, const char *script,
+                  struct scriptstats *ss, double start, double now)
+{
+    int i;
+
+    /* If pid is not 0 we have a child, did it exit and is the IDKEYDLY
+     * after it over
+     */
+    for (i = 0; *pid && i < nexits; ++i) {
+        if (exits[i].pid == *pid && now >= exits[i].at + conf.idkeydly) {
+            script_exited(r, pid, script, ss, start, exits[i].status, now);
+            exits[i] = exits[--nexits];
         }
     }
 }
 
-/* Timing source */
-double dnow()
+/* Account the time from a script exit to the unkey it led to */
+void rpt_unkeyed(struct rpt *r, double now)
 {
-    struct timeval tv;
-    if( gettimeofday(&tv, NULL) < 0 ) return (0);
-    else return(1000*((double)tv.tv_sec + 1.e-6 * (double)tv.tv_usec));
+    uint64_t us;
+
+    if (r->exitat > 0) {
+        us = (now - r->exitat) * 1000;
+        r->exited->unkeyus = us;
+        if (us > r->exited->maxunkeyus)
+            r->exited->maxunkeyus = us;
+        r->exitat = 0;
+    }
 }
 
-int main(int argc, char *argv[])
-/* Main function */
-  {  
-    int irlpdev = 0;
-    unsigned char c[2];          /* Returned string from parallel port */
+/* Anything going on that needs the inputs sampled fast */
+int rpt_active(struct rpt *r)
+{
+    return (r->in[0] & r->port.pins.cos) ||
+           (r->in[1] & r->port.pins.irlpkey) || r->keyflag;
+}
+
+/* Time to the nearest timer acting while the transmitter is down, the
+ * others run while we sample fast anyway. Negative if there is none.
+ */
+double rpt_due(struct rpt *r, double now)
+{
+    double due = -1, t = -1;
 
-    pid_t ctpid = 0;             /* Keep track of spawned courtesy script */
-    pid_t idpid = 0;             /* Kepp track of spawned ider script */
-
-    int idstate = 0;             /* Determines state of ID */
-    int ctbusy = 0;              /* Flag while courtesy script executing */
-    int idbusy = 0;              /* Flag while id script executing */
-    int ctflag = 1;              /* Flag when the courtesy tone has played */
-    int idflag = 1;              /* Flag when the ID tone has played */
-    int muteflag = 0;            /* Flag when the muter is on */
-    int keyflag = 0;             /* Flag when the system (AUX1) is keyed */
-    int shortkeyflag = 0;        /* Flag when the shortkey feature is active */
-    int forcekeyflag = 0;        /* Flag when the forcekey feature is active */
-    int fanflag = 0;             /* Flag when the fan is active */
-    int irlpflag = 0;            /* Flag when IRLP keyed and is active */
+    if (!r->keyflag && r->fanflag)
+        due = conf.fandelay - (now - r->fantimer);
+    if (r->idstate == 1 && !r->idpid)
+        t = conf.idwait - (now - r->idtimer);
+    if (r->idstate == 2 && !r->idpid)
+        t = conf.idperiod + conf.idwait - (now - r->idtimer);
+    if (t >= 0 && (due < 0 || t < due))
+        due = t;
+    t = health_due(&r->health, now);
+    if (t >= 0 && (due < 0 || t < due))
+        due = t;
+    return due;
+}
+
+/* Flags of a port sample as seen on the hardware */
+unsigned char sample_flags(struct port *p, unsigned char *c)
+{
+    unsigned char f = 0;
 
+    if (c[0] & p->pins.cos)         f |= PS_COS;
+    if ((c[0] >> 3) & 0x0f)         f |= PS_DTMF;
+    if (c[1] & p->pins.irlpkey)     f |= PS_IRLPKEY;
+    if (c[1] & p->pins.key)         f |= PS_KEY;
+    if (!(c[1] & p->pins.mute))     f |= PS_MUTE;
+    if (c[1] & p->pins.fan)         f |= PS_FAN;
+    if (!(c[1] & p->pins.ctcss))    f |= PS_CTCSS;
+    if (c[1] & p->pins.aux5)        f |= PS_AUX5;
+    return f;
+}
+
+/* Sets default settings for the repeater variables */
+void rpt_init(struct rpt *r)
+{
+    r->ctpid = 0;
+    r->idpid = 0;
+    r->idstate = 0;
+    r->ctbusy = 0;
+    r->idbusy = 0;
+    r->anpid = 0;
+    r->anbusy = 0;
+    r->nanq = 0;
+    r->ctflag = 1;
+    r->idflag = 1;
+    r->muteflag = 0;
+    r->keyflag = 0;
+    r->shortkeyflag = 0;
+    r->forcekeyflag = 0;
+    r->fanflag = 0;
+    r->irlpflag = 0;
+    r->ctlkeyflag = 0;
+    r->ctlmuteflag = 0;
+    r->pwmflag = 0;
+    r->txduty = 0;
+    r->set = 0;
+    r->clr = 0;
+    r->mutetimer = 0;
+    r->hangtimer = 0;
+    r->cttimer = 0;
+    r->idtimer = 0;
+    r->shortkeytimer = 0;
+    r->fantimer = 0;
+    r->ctstart = 0;
+    r->idstart = 0;
+    r->anstart = 0;
+    r->exitat = 0;
+    r->exited = NULL;
+    r->last = 0;
+}
+
+/* One pass of the controller logic for a single repeater */
+void rpt_tick(struct rpt *r, double now)
+{
+    unsigned char c[2];          /* Returned string from parallel port */
     unsigned char COS = '1';     /* Character which determines the state of the 
                                     COS. Capitals used to avoid confusion with 
                                     the cosine function */
@@ -173,25 +615,780 @@ int main(int argc, char *argv[])
                                     DTMF tone is recieved */
     unsigned char irlpkey;       /* Character which determines when IRLP 
                                     software has the key triggered */
-    struct timespec tim;         /* Timespec for the loop timer function */
-    double mutetimer = 0;        /* Definition of the timer to measure time 
-                                    bewteen mute on and mute off */
-    double hangtimer = 0;        /* Definition of the timer to measure time 
-                                    bewteen start of key and unkey */
-    double cttimer = 0;          /* Definition of the timer to measure time 
-                                    bewteen unkey and the playing of the 
-                                    courtesy tone */
-    double idtimer = 0;          /* Definition of the timer to measure time
-                                    between keyup and the playing of the ID */
-    double shortkeytimer = 0;    /* Definition of the timer to measure time 
-                                    bewteen mute on and mute off */
-    double fantimer = 0;         /* Definition of the time to measure time
-                                    from transmit drop to fan off */
+    double dt, d;
+
+    /*
+     * Airtime, accounts the time since the last pass in the state we
+     * left it in
+     */
+
+    dt = (now - r->last) * 1000;
+    if (r->last > 0 && dt > 0) {
+        if (r->keyflag) {
+            r->st->txus += dt;
+            if (r->irlpflag)
+                r->st->irlpus += dt;
+            else
+                r->st->localus += dt;
+        }
+        if (r->fanflag)
+            r->st->fanus += dt;
+
+        /* Averaged over the fan delay, drives the duty of the PWM */
+        d = dt / 1000 / (conf.fandelay > 0 ? conf.fandelay : 1);
+        r->txduty += ((r->keyflag ? 1 : 0) - r->txduty) * (d < 1 ? d : 1);
+    }
+    r->last = now;
+
+    /*
+     * Get input
+     */
+
+    /* A port out of service is left alone until it is time to reopen it */
+    if (r->health.down) {
+        if (!health_retry(&r->health, now))
+            return;
+        irlpdev_close(&r->port.dev);
+        if (irlpdev_open(&r->port.dev) < 0) {
+            health_fail(&r->health, now, r->port.name, &r->port.dev);
+            return;
+        }
+    }
+
+    /* Reads the input and output bit from the port, a pass that could not
+     * is skipped rather than run on the inputs of the last one
+     */
+    if (port_read(&r->port, c) != 2) {
+        if (health_fail(&r->health, now, r->port.name, &r->port.dev))
+            rpt_down(r);
+        return;
+    }
+    if (health_ok(&r->health, now, r->port.name)) {
+        r->set = 0;             /* Queued while down, by the watchdog */
+        r->clr = 0;
+        rpt_safe(r);
+        pwm_resume(&r->port);
+        wd_resume(&r->port);
+        beacon_resume(&r->port);
+    }
+    r->st->cosglitches = r->port.filter.line[LINE_COS].glitches;
+    r->st->dtmfglitches = r->port.filter.line[LINE_DTMF].glitches;
+
+    /* Determines the status of various inputs and outputs from the port */
+    COS = (c[0] & r->port.pins.cos) ? 1 : 0;
+    dtmf = (c[0] >> 3) & 0x0f;
+    irlpkey = c[1] & r->port.pins.irlpkey;
+    PROBE3(repeater, input, r->port.id, c[0], c[1]);
+
+    /* Publish the sample for portread and friends */
+    stats_publish(shared, r->port.id, c, sample_flags(&r->port, c), dtmf,
+                  (uint64_t)(now * 1000));
+
+    /* Record input edges, at the time the kernel or the input filter
+     * dated them if they did. Only a kernel time is exact for the sampler.
+     */
+    if (c[0] != r->in[0] || irlpkey != (r->in[1] & r->port.pins.irlpkey)) {
+        if (r->port.edgeus)
+            rec_time(r->port.edgeus);
+        rec_put(REC_INPUT, r->port.id, c[0], c[1]);
+        sampler_edge(&sampler, now, r->port.dev.edgeus / 1000.0);
+        rec_time((uint64_t)(now * 1000));
+        r->in[0] = c[0];
+        r->in[1] = c[1];
+    }
+
+    /*
+     * FAN control
+     */
+    
+    /* This controles the fan. If the radio has been keyed we turn on
+     * the fan.
+     */
+    if (r->keyflag && !r->fanflag) {
+        r->fanflag = rpt_out(r, "fanon", ON);
+    }
+    /* Unkey 5 minutes (300,000 ms) after transmitter dropped */
+    if (!r->keyflag && r->fanflag && now - r->fantimer > conf.fandelay) {
+        rec_put(REC_TIMER, r->port.id, RT_FAN, 0);
+        r->fanflag = rpt_out(r, "fanoff", OFF);
+    }
+    /* fantimer is being set as long as we are keyed */
+    if (r->keyflag) {
+        r->fantimer = now;
+    }
+    
+    /*
+     * MUTE control
+     */
+    
+    /* This sets the muter, muteflag, and mutetimer when DTMF is detected
+     * It also resets the mute if no DTMF is present, and the timer has 
+     * elapsed.
+     */
+    if (COS) {
+        if (dtmf >= 1 && dtmf <= 17) {
+            if (!r->muteflag)
+                r->muteflag = rpt_out(r, "mute", ON);
+            r->mutetimer = now;
+        } else {
+            if (r->muteflag) {
+                if (((now - r->mutetimer) > conf.mutetime) && r->muteflag &&
+                        !r->ctlmuteflag) {
+                    rec_put(REC_TIMER, r->port.id, RT_MUTE, 0);
+                    r->muteflag = rpt_out(r, "unmute", OFF);
+                }
+            }
+        }
+    }
+
+    /* This mutes repeated audio if there is no COS or we are told to */
+    if ((!COS || r->ctlmuteflag) && !r->muteflag) {
+        r->muteflag = rpt_out(r, "mute", ON);
+    }
+   
+    /*
+     * Events that KEY
+     */
+    
+    /* This is the start of the hangtimer. It detects COS and determines 
+     * whether to key up or reset the hangtimer, depending on keyflag. 
+     * Embedded is also the timer for the shortkey system 
+     */
+    if (COS) {
+        if (!r->keyflag) {
+            r->keyflag = rpt_out(r, "keyup", ON);
+            r->st->keyups++;
+            r->shortkeytimer = now;
+        }
+        r->hangtimer = now;
+        r->cttimer = now;
+        r->ctflag = 0;
+        r->idflag = 0;
+        r->exitat = 0;
+    }
+    /* Determines if the IRLP software has keyed the radio, and sets the 
+     * hangtimer, and keys up the radio. 
+     */
+    if (irlpkey) {
+        if (!r->keyflag) {
+            r->keyflag = rpt_out(r, "keyup", ON);
+            r->st->keyups++;
+            r->shortkeytimer = now;
+        }
+        r->hangtimer = now;
+        r->cttimer = now;
+        r->irlpflag = 1;
+        r->idflag = 0;
+        r->exitat = 0;
+    }
+    /* The forcekeyflag does just that, keys programmatically, as does
+     * a key from the control socket
+     */
+    if(r->forcekeyflag || r->ctlkeyflag) {
+        if (!r->keyflag) {
+            r->keyflag = rpt_out(r, "keyup", ON);
+            r->st->keyups++;
+            r->shortkeytimer = now;
+        }
+        r->hangtimer = now;
+    }
+
+    /*
+     * Shortkey feature
+     */
+
+    /* Once the shortkey timer is exceeded, it stops the shortkey 
+     * features from unkeying the radio.
+     */
+    if (COS || irlpkey || r->forcekeyflag || r->ctlkeyflag) { 
+        if (!r->shortkeyflag && now - r->shortkeytimer > conf.shortkey) {
+            rec_put(REC_TIMER, r->port.id, RT_SHORTKEY, 0);
+            rpt_log(r, "Shortkey exceeded");
+            r->shortkeyflag = 1;
+        }
+    }
+
+    /*
+     * Play the courtesy tone
+     */
+
+    /* Once COS is dropped, and the cttimer is exceeded, we play the 
+     * courtesy tone. Do not CT over ID. 
+     */
+    if (!COS && !irlpkey && !r->idbusy && !r->anbusy) {
+        /* If IRLP was last to drop cttimer is shorter because IRLP
+         * has a longer delay before unkey
+         */
+        if (!r->ctflag && !r->ctpid && r->irlpflag && now - r->cttimer > conf.cttimei) {
+            rec_put(REC_TIMER, r->port.id, RT_CT, 0);
+            do_ct(r);
+            r->ctbusy = 1;
+            r->forcekeyflag = 1;
+        }
+        /* If COS was last to drop cttimer is longer */
+        if (!r->ctflag && !r->ctpid && !r->irlpflag && now - r->cttimer > conf.cttime) {
+            rec_put(REC_TIMER, r->port.id, RT_CT, 0);
+            do_ct(r);
+            r->ctbusy = 1;
+            r->forcekeyflag = 1;
+        }
+    }
+    /* Handle forked child script */
+    check_script(r, &r->ctpid, BEEP_SCRIPT, &r->st->ct, r->ctstart, now);
+    if (!r->ctpid && r->ctbusy && r->forcekeyflag) {
+        r->ctbusy = 0;
+        r->ctflag = 1;
+        r->forcekeyflag = 0;
+    }
+
+    /*
+     * Play the ID
+     *
+     * The idflag is cleared by keyup and set upon playing of ID. We
+     * cannot use the keyfkag in its case because the keyup to play
+     * ID would then trigger the ID requirement causing an endless loop.
+     *
+     * The idbusy flag is required to properly detect end of script
+     * execution and setting and clearing of flags associated with that
+     * event. It ensure this is a one shot event at the end of script
+     * execution.
+     *
+     * The idstate is more then just true or false here. We track the
+     * following states
+     *
+     *      0   idle
+     *      1   immediate ID pending
+     *      2   delayed ID pending
+     *      3   ID played
+     */
+
+    /* ID requirement from idle */
+    if (r->idstate == 0 && !r->idflag) {
+        r->idstate = 1;
+        r->idtimer = now;
+        rpt_log(r, "ID: immediate");
+    }
+    /* Repeated ID requirement */
+    if (r->idstate == 3 && !r->idflag) {
+        r->idstate = 2;
+        //idtimer = dnow();
+        rpt_log(r, "ID: delayed");
+    }
+    /* Immediate ID required */
+    if (r->idstate == 1 && !r->idpid && !r->anpid) {
+        /* Tuck behind courtesy tone */
+        if (!COS && !irlpkey && r->keyflag && r->ctflag) {
+            do_id(r);
+            r->idbusy = 1;
+            r->forcekeyflag = 1;
+            r->idtimer = now;
+        }
+        /* ID if we timeout */
+        if (now - r->idtimer > conf.idwait) {
+            rec_put(REC_TIMER, r->port.id, RT_IDWAIT, 0);
+            do_id(r);
+            r->idbusy = 1;
+            r->forcekeyflag = 1;
+            r->idtimer = now;
+        }
+    }
+    /* Delayed ID required */
+    if (r->idstate == 2 && !r->idpid && !r->anpid) {
+        /* Tuck behind courtesy tone */
+        if (!COS && !irlpkey && r->keyflag && r->ctflag && 
+                now - r->idtimer > conf.idperiod) {
+            rec_put(REC_TIMER, r->port.id, RT_IDPERIOD, 0);
+            do_id(r);
+            r->idbusy = 1;
+            r->forcekeyflag = 1;
+            r->idtimer = now;
+        }
+        /* ID if we timeout */
+        if (now - r->idtimer > conf.idperiod + conf.idwait) {
+            rec_put(REC_TIMER, r->port.id, RT_IDWAIT, 0);
+            do_id(r);
+            r->idbusy = 1;
+            r->forcekeyflag = 1;
+            r->idtimer = now;
+        }
+    }
+    /* Reset ID */
+    if (r->idstate == 3 && now - r->idtimer > conf.idperiod + conf.idwait) {
+        r->idstate = 0;
+        rec_put(REC_TIMER, r->port.id, RT_IDRESET, 0);
+        rpt_log(r, "ID: reset");
+    }
+
+    /* Handle forked child script */
+    check_script(r, &r->idpid, IDER_SCRIPT, &r->st->id, r->idstart, now);
+    if (!r->idpid && r->idbusy && r->forcekeyflag) {
+        r->idbusy = 0;
+        r->idflag = 1;
+        r->idstate = 3;
+        r->forcekeyflag = 0;
+    }
+
+    /*
+     * Play announcements
+     *
+     * An announcement that fell due waits for the channel like an ID
+     * does. It is tucked behind the courtesy tone or played as soon as
+     * the repeater is idle, never over a user, the courtesy tone or an
+     * ID. It keys the transmitter like any other and so calls for an ID.
+     */
+    if (r->nanq && !r->anpid && !r->ctpid && !r->idpid && !r->ctbusy &&
+            !r->idbusy && !COS && !irlpkey && (!r->keyflag || r->ctflag)) {
+        do_announce(r);
+        r->anbusy = 1;
+        r->forcekeyflag = 1;
+        r->idflag = 0;
+    }
+    check_script(r, &r->anpid, ANNOUNCE_SCRIPT, &r->st->an, r->anstart, now);
+    if (!r->anpid && r->anbusy && r->forcekeyflag) {
+        r->anbusy = 0;
+        r->forcekeyflag = 0;
+    }
+    
+    /*
+     * Events that UNKEY
+     */
+
+    /* If the shortkey timer has not been exceeded, and COS is dropped, 
+     * we drop the transmitter. It also makes sure there is no courtesy 
+     * tones. 
+     */
+    if (!COS && !irlpkey && !r->forcekeyflag && !r->ctlkeyflag &&
+            r->keyflag && !r->shortkeyflag) {
+        r->keyflag = rpt_out(r, "unkey", OFF);
+        rpt_unkeyed(r, now);
+        r->st->kerchunks++;
+        r->ctflag = 1;
+        r->idflag = 1;
+        r->irlpflag = 0;
+        r->shortkeyflag = 0;
+    }
+    /* When the hangtime is exceeded, the radio is unkeyed, and the 
+     * shortkeytimer is reset. 
+     */
+    if (!COS && !irlpkey && !r->forcekeyflag && !r->ctlkeyflag &&
+            r->keyflag && (now - r->hangtimer > conf.hangtime)) {
+        rec_put(REC_TIMER, r->port.id, RT_HANG, 0);
+        r->keyflag = rpt_out(r, "unkey", OFF);
+        rpt_unkeyed(r, now);
+        r->irlpflag = 0;
+        r->shortkeyflag = 0;
+    }
+
+    /* Write what changed this pass */
+    rpt_flush(r, now);
+    pwm_set(r->port.id, r->pwmflag, r->port.pwm.min * 10 +
+            (r->port.pwm.max - r->port.pwm.min) * 10 * r->txduty);
+}
+
+/* Apply a control socket command to the state of a repeater, the changes
+ * reach the port with the next pass like those of the controller itself.
+ */
+void rpt_command(struct rpt *r, char *cmd, double now)
+{
+    char **c;
+
+    if (!strcmp(cmd, "key") || !strcmp(cmd, "keyup"))
+        r->ctlkeyflag = 1;
+    if (!strcmp(cmd, "unkey")) {
+        r->ctlkeyflag = 0;
+        r->hangtimer = now - conf.hangtime - 1;
+    }
+    if (!strcmp(cmd, "mute"))
+        r->ctlmuteflag = 1;
+    if (!strcmp(cmd, "unmute")) {
+        r->ctlmuteflag = 0;
+        r->mutetimer = now - conf.mutetime - 1;
+    }
+    if (!strcmp(cmd, "fanon")) {
+        if (!r->fanflag)
+            r->fanflag = rpt_out(r, "fanon", ON);
+        r->fantimer = now;
+    }
+    if (!strcmp(cmd, "fanoff") && r->fanflag && !r->keyflag)
+        r->fanflag = rpt_out(r, "fanoff", OFF);
+    if (!strcmp(cmd, "ct") && !r->ctpid && !r->idpid) {
+        do_ct(r);
+        r->ctbusy = 1;
+        r->forcekeyflag = 1;
+    }
+    if (!strcmp(cmd, "id") && !r->idpid) {
+        r->idstate = 1;
+        r->idtimer = now - conf.idwait - 1;
+    }
+
+    /* Pins the controller does not track, logged by their static name */
+    for (c = ctlcmds; *c != NULL; ++c)
+        if (!strcmp(cmd, *c) && (!strncmp(cmd, "ctcss", 5) ||
+                    !strncmp(cmd, "aux", 3)))
+            rpt_out(r, *c, ON);
+}
+
+/* Describe the state of a repeater for a control socket reply */
+void rpt_status(struct rpt *r, char *buf, int n)
+{
+    unsigned char out = r->port.out;
+
+    snprintf(buf, n, "ok %s key=%d mute=%d fan=%d ctcss=%d aux4=%d aux5=%d "
+             "ct=%d id=%d data=0x%02x down=%d\n", r->port.name, r->keyflag,
+             r->muteflag, r->fanflag, !(out & r->port.pins.ctcss),
+             (out & r->port.pins.aux4) ? 1 : 0,
+             (out & r->port.pins.aux5) ? 1 : 0, r->ctbusy, r->idstate, out,
+             r->health.down);
+}
+
+/* Take a control request apart and apply it. Either all its commands
+ * are applied or none and the request is answered with an error.
+ */
+struct rpt *ctl_apply(int fd, struct ctlmsg *m, double now)
+{
+    struct rpt *r = NULL;
+    char *tok[CTLMSG / 2], *save, *base, **c;
+    char err[CTLMSG];
+    int i, n = 0;
+
+    tok[n] = strtok_r(m->buf, " \t\r\n", &save);
+    while (tok[n] != NULL && n < CTLMSG / 2 - 1)
+        tok[++n] = strtok_r(NULL, " \t\r\n", &save);
+    if (n < 2) {
+        ctl_reply(fd, m, "error usage: PORT CMD [CMD ...]\n");
+        return NULL;
+    }
+
+    /* Ports go by their name or the name of their device */
+    for (i = 0; i < nrpts && r == NULL; ++i) {
+        base = strrchr(rpts[i].port.dev.path, '/');
+        base = base ? base + 1 : rpts[i].port.dev.path;
+        if (!strcmp(tok[0], rpts[i].port.name) || !strcmp(tok[0], base) ||
+                !strcmp(tok[0], rpts[i].port.dev.path))
+            r = &rpts[i];
+    }
+    if (r == NULL) {
+        snprintf(err, sizeof(err), "error unknown port %s\n", tok[0]);
+        ctl_reply(fd, m, err);
+        return NULL;
+    }
+
+    for (i = 1; i < n; ++i) {
+        for (c = ctlcmds; *c != NULL && strcmp(tok[i], *c); ++c)
+            ;
+        if (*c == NULL) {
+            snprintf(err, sizeof(err), "error unknown command %s\n", tok[i]);
+            ctl_reply(fd, m, err);
+            return NULL;
+        }
+        if (r->health.down && strcmp(tok[i], "status")) {
+            snprintf(err, sizeof(err), "error port %s is out of service\n",
+                     r->port.name);
+            ctl_reply(fd, m, err);
+            return NULL;
+        }
+    }
+    for (i = 1; i < n; ++i)
+        rpt_command(r, tok[i], now);
+    return r;
+}
+
+/* Ask for the configuration to be read again */
+void sighup(int sig)
+{
+    reload = 1;
+}
+
+/* Ask for a graceful shutdown */
+void sigterm(int sig)
+{
+    quit = 1;
+}
+
+/* Keep what a restarted controller needs to carry on */
+void rpt_save(struct rpt *r, struct portsave *ps)
+{
+    snprintf(ps->name, sizeof(ps->name), "%s", r->port.name);
+    ps->out = r->port.out;
+    ps->idstate = r->idstate;
+    ps->idflag = r->idflag;
+    ps->ctflag = r->ctflag;
+    ps->keyflag = r->keyflag;
+    ps->muteflag = r->muteflag;
+    ps->fanflag = r->fanflag;
+    ps->irlpflag = r->irlpflag;
+    ps->shortkeyflag = r->shortkeyflag;
+    ps->ctlkeyflag = r->ctlkeyflag;
+    ps->ctlmuteflag = r->ctlmuteflag;
+    ps->pwmflag = r->pwmflag;
+    ps->txduty = r->txduty;
+    ps->mutetimer = r->mutetimer;
+    ps->hangtimer = r->hangtimer;
+    ps->cttimer = r->cttimer;
+    ps->idtimer = r->idtimer;
+    ps->shortkeytimer = r->shortkeytimer;
+    ps->fantimer = r->fantimer;
+    ps->st = *r->st;
+}
+
+/* The outputs a saved state carries, the PWM and beacon pins are driven
+ * by their threads
+ */
+static unsigned char rpt_outs(struct rpt *r)
+{
+    unsigned char outs;
+
+    outs = r->port.pins.key | r->port.pins.mute | r->port.pins.ctcss |
+           r->port.pins.fan | r->port.pins.aux4 | r->port.pins.aux5;
+    return outs & ~(r->port.pwm.pin | r->port.beacon.pin);
+}
+
+/* The saved state of a port by name, NULL if there is none */
+static struct portsave *saved_port(struct statesave *s, const char *name)
+{
+    uint32_t n;
+
+    for (n = 0; s != NULL && n < s->nports; ++n)
+        if (!strcmp(s->port[n].name, name))
+            return &s->port[n];
+    return NULL;
+}
+
+/* Carry on from a saved state, the outputs are written once as they were.
+ * Taking over from a running controller they already are, and the keys
+ * held through its control socket stay. It hands over only while no
+ * script plays, after a restart the scripts of the last controller are
+ * not ours to wait for.
+ */
+void rpt_restore(struct rpt *r, struct portsave *ps, int handoff)
+{
+    unsigned char outs = rpt_outs(r);
+
+    r->idstate = ps->idstate;
+    r->idflag = ps->idflag;
+    r->ctflag = ps->ctflag;
+    r->keyflag = ps->keyflag;
+    r->muteflag = ps->muteflag;
+    r->fanflag = ps->fanflag;
+    r->irlpflag = ps->irlpflag;
+    r->shortkeyflag = ps->shortkeyflag;
+    r->pwmflag = ps->pwmflag;
+    r->txduty = ps->txduty;
+    r->mutetimer = ps->mutetimer;
+    r->hangtimer = ps->hangtimer;
+    r->cttimer = ps->cttimer;
+    r->idtimer = ps->idtimer;
+    r->shortkeytimer = ps->shortkeytimer;
+    r->fantimer = ps->fantimer;
+    *r->st = ps->st;
+
+    if (handoff) {
+        r->ctlkeyflag = ps->ctlkeyflag;
+        r->ctlmuteflag = ps->ctlmuteflag;
+        r->port.out = ps->out;
+        return;
+    }
+    portctl_masks(&r->port, ps->out & outs, ~ps->out & outs, "resume");
+}
+
+/*
+ * Hand control to a new controller between two passes. It has to be
+ * built with the same state layout. Returns 1 once it confirmed it has our
+ * state and descriptors, we must not touch the ports after that.
+ */
+int rpt_handoff(int ctlfd, int pidfd, struct ctlmsg *m)
+{
+    struct handoff ho;
+    int fds[2 + MAXPORTS];
+    int i, size, version;
+    char buf[LOGTXT];
+
+    /* A confirmation that came too late, we carried on */
+    if (!strcmp(m->buf, CTLTAKEN)) {
+        ctl_reply(ctlfd, m, "error handoff given up");
+        return 0;
+    }
+
+    if (sscanf(m->buf, "handoff %d %d", &size, &version) != 2 ||
+            size != (int)sizeof(ho) || version != STATEVERSION) {
+        snprintf(buf, sizeof(buf), "error handoff needs size %d version %d",
+                 (int)sizeof(ho), STATEVERSION);
+        ctl_reply(ctlfd, m, buf);
+        do_log("Handoff: refused, state layout differs");
+        return 0;
+    }
+
+    for (i = 0; i < nrpts; ++i)
+        if (rpts[i].health.down) {
+            snprintf(buf, sizeof(buf), "error port %s is out of service",
+                     rpts[i].port.name);
+            ctl_reply(ctlfd, m, buf);
+            do_log("Handoff: refused, a port is out of service");
+            return 0;
+        }
+
+    /* A script playing is ours to wait for, the taker asks again */
+    for (i = 0; i < nrpts; ++i)
+        if (rpts[i].ctpid || rpts[i].idpid || rpts[i].anpid ||
+                rpts[i].ctbusy || rpts[i].idbusy || rpts[i].anbusy ||
+                rpts[i].forcekeyflag) {
+            snprintf(buf, sizeof(buf), "error busy port %s plays a script",
+                     rpts[i].port.name);
+            ctl_reply(ctlfd, m, buf);
+            return 0;
+        }
+
+    memset(&ho, 0, sizeof(ho));
+    fds[0] = pidfd;
+    fds[1] = ctlfd;
+    for (i = 0; i < nrpts; ++i) {
+        rpt_save(&rpts[i], &ho.save.port[i]);
+        fds[2 + i] = rpts[i].port.dev.fd;
+    }
+    ho.save.nports = nrpts;
+    ho.save.saved = dnow();
+    stats_commit(shared, stats);    /* The taker opens the counters next */
+    pwm_stop();                 /* The new one drives the pins from now */
+    beacon_stop();
+    if (ctl_handoff(ctlfd, m, &ho, sizeof(ho), fds, 2 + nrpts) < 0) {
+        snprintf(buf, sizeof(buf), "Handoff: failed: %s", strerror(errno));
+        do_log(buf);
+        pwm_start();
+        beacon_start();
+        return 0;
+    }
+
+    /* The ports stay ours until the new one confirms it has them */
+    if (ctl_handed(ctlfd, m, wd_beat) < 0) {
+        do_log("Handoff: no word from the new controller, carrying on");
+        pwm_start();
+        beacon_start();
+        return 0;
+    }
+    do_log("Handoff: new controller took over");
+    return 1;
+}
+
+/* Add what the counters gained since the last time to the history, the
+ * times in whole ms with the rest left for the next time
+ */
+void rpt_history(struct rpt *r, int port, time_t t)
+{
+    uint32_t v[HISTMETRICS];
+
+    v[HM_TX] = (r->st->txus - r->hist.txus) / 1000;
+    v[HM_KEYUPS] = r->st->keyups - r->hist.keyups;
+    v[HM_IRLP] = (r->st->irlpus - r->hist.irlpus) / 1000;
+    v[HM_FAN] = (r->st->fanus - r->hist.fanus) / 1000;
+    r->hist.txus += (uint64_t)v[HM_TX] * 1000;
+    r->hist.keyups += v[HM_KEYUPS];
+    r->hist.irlpus += (uint64_t)v[HM_IRLP] * 1000;
+    r->hist.fanus += (uint64_t)v[HM_FAN] * 1000;
+    hist_add(port, t, v);
+}
+
+/* Safe all ports, for the supervisor when the controller died. The ports
+ * are let go again so the next controller doesn't inherit them.
+ */
+void safe_all(void)
+{
+    int i;
+
+    for (i = 0; i < nrpts; ++i) {
+        rpt_safe(&rpts[i]);
+        irlpdev_close(&rpts[i].port.dev);
+    }
+}
+
+/* Take a new configuration. Timers run from the time they were started,
+ * so a changed value moves their expiry and one already past expires on
+ * the next pass.
+ */
+void rpt_reload(const char *path)
+{
+    struct rptconf nc = conf;
+    char buf[LOGTXT];
+    int i, d;
+
+    if (conf_load(path, &nc) < 0) {
+        do_log("Config: rejected, keeping the running one");
+        return;
+    }
+    for (i = 0; (d = conf_diff(&conf, &nc, i, buf, sizeof(buf))) >= 0; ++i)
+        if (d)
+            do_log(buf);
+    conf = nc;
+    sampler_set(&sampler, conf.fastpoll, conf.idlepoll, conf.polldecay);
+    stats->fastms = sampler.fast;
+    stats->idlems = sampler.idle;
+}
+
+/* Read the announcement schedule again, announcements already waiting
+ * for their port still play
+ */
+void rpt_schedule(const char *path)
+{
+    char buf[LOGTXT];
+    int n;
+
+    if ((n = cal_load(&cal, path, time(NULL))) < 0) {
+        do_log("Schedule: rejected, keeping the running one");
+        return;
+    }
+    snprintf(buf, sizeof(buf), "Schedule: %d announcements", n);
+    do_log(buf);
+}
+
+/* Histogram bucket of a late pass, doubling from STALLBASE ms */
+int stall_bucket(double gapus)
+{
+    int b = 0;
+    double g = gapus / 1000 / STALLBASE;
+
+    while (g >= 2 && b < STALLBUCKETS - 1) {
+        g /= 2;
+        ++b;
+    }
+    return b;
+}
+
+int main(int argc, char *argv[])
+/* Main function */
+  {  
+    int i, n, nctl, stall, wait, active;
+    int sigfd, chld = 0;         /* Script exits arrive here */
+    sigset_t sigs;
+    struct signalfd_siginfo si;
+    struct pollfd pfd[2 + MAXPORTS]; /* What ends the wait for the next pass */
+    double now, last, gap, due, d;
+    char *recfile = RECFILE;     /* Flight recorder */
+    char *statefile = STATEFILE; /* Kept for a restart */
+    char *histfile = HISTFILE;   /* Usage per minute, hour and day */
+    char *schedfile = CALFILE; /* Announcements */
+    int schedfd = -1;
+    time_t histsec = 0;
+    struct statesave *saved;
+    struct portsave *ps;
+    char *ctlpath = CTLSOCK;     /* Control socket */
+    char *conffile = CONFFILE;   /* Timing configuration */
+    char *pidfile = PIDFILE;     /* Keeps us the only controller */
+    int supervised = 0;
+    int upgrade = 0;             /* Take over from a running controller */
+    int handed = 0;              /* and we were taken over */
+    struct handoff ho, *handoff = NULL;
+    int hofds[CTLFDS];
+    int pidfd = -1;
+    int conffd = -1;
+    int ctlfd = -1;
+    struct ctlmsg ctl[CTLQUEUE]; /* Control requests of this pass */
+    struct rpt *ctlrpt[CTLQUEUE];
+    char reply[CTLMSG];
+    char buf[LOGTXT];
 
     /* Look for the command line arg we know of */
     while (argc > 1) {
         if (!strcmp(argv[1], "-h")) {
-            fprintf(stderr, usage);
+            fprintf(stderr, usage, MAXPORTS);
             return -1;
         }
         if (!strcmp(argv[1], "-v")) {
@@ -200,295 +1397,434 @@ int main(int argc, char *argv[])
         if (!strcmp(argv[1], "-l")) {
             logging = 1;
         }
+        if (!strcmp(argv[1], "-s")) {
+            supervised = 1;
+        }
+        if (!strcmp(argv[1], "-u")) {
+            upgrade = 1;
+        }
+        if (!strcmp(argv[1], "-P") && argc > 2) {
+            pidfile = argv[2];
+            --argc;
+            ++argv;
+        }
+        if (!strcmp(argv[1], "-p") && argc > 2) {
+            if (nrpts >= MAXPORTS) {
+                fprintf(stderr, "Support up to %d ports\n", MAXPORTS);
+                return -1;
+            }
+            if (port_config(&rpts[nrpts].port, argv[2]) < 0) {
+                fprintf(stderr, "Invalid port %s\n", argv[2]);
+                return -1;
+            }
+            rpts[nrpts].port.id = nrpts;
+            ++nrpts;
+            --argc;
+            ++argv;
+        }
+        if (!strcmp(argv[1], "-r") && argc > 2) {
+            recfile = argv[2];
+            --argc;
+            ++argv;
+        }
+        if (!strcmp(argv[1], "-S") && argc > 2) {
+            statefile = argv[2];
+            --argc;
+            ++argv;
+        }
+        if (!strcmp(argv[1], "-H") && argc > 2) {
+            histfile = argv[2];
+            --argc;
+            ++argv;
+        }
+        if (!strcmp(argv[1], "-a") && argc > 2) {
+            schedfile = argv[2];
+            --argc;
+            ++argv;
+        }
+        if (!strcmp(argv[1], "-f") && argc > 2) {
+            conffile = argv[2];
+            --argc;
+            ++argv;
+        }
+        if (!strcmp(argv[1], "-c") && argc > 2) {
+            ctlpath = argv[2];
+            --argc;
+            ++argv;
+        }
         --argc;
         ++argv;
     }
 
-    /* Open syslog */
+    /* Without any port given we drive the IRLP default */
+    if (!nrpts) {
+        port_init(&rpts[0].port, IRLPDEV_PATH);
+        nrpts = 1;
+    }
+
+    /* Timing values, a missing default file leaves the defaults */
+    conf_defaults(&conf);
+    if ((strcmp(conffile, CONFFILE) || access(conffile, F_OK) == 0) &&
+            conf_load(conffile, &conf) < 0)
+        return -1;
+
+    /* Take over from a running controller. It passes its state and the
+     * descriptors of the pidfile, control socket and ports, and stops
+     * between two passes. Without one we start as usual.
+     */
+    if (upgrade && strcmp(ctlpath, "none")) {
+        snprintf(reply, sizeof(reply), "handoff %d %d", (int)sizeof(ho),
+                 STATEVERSION);
+        for (i = 0; ; ++i) {
+            n = ctl_takeover(ctlpath, reply, &ho, sizeof(ho), hofds, CTLFDS);
+            if (n >= 0 || errno != EBUSY || i == HANDOFFTRIES)
+                break;
+            sleep(1);
+        }
+        if (n < 0 && errno != ENOENT && errno != ECONNREFUSED) {
+            fprintf(stderr, "Can't take over: %s\n", strerror(errno));
+            return -1;
+        }
+        if (n >= 2) {
+            pidfd = hofds[0];
+            ctlfd = hofds[1];
+            pidfile_adopt(pidfd);
+            handoff = &ho;
+        }
+    }
+
+    /* Only one of us, the supervisor holds the pidfile for its child */
+    if (pidfd < 0 && (pidfd = pidfile_lock(pidfile)) < 0)
+        return -1;
+
+    /* Open syslog, log output is done by its own thread from here on */
     if (logging)
         open_syslog(PROG);
+    if (supervised && supervise(pidfd, safe_all) < 0) {
+        fprintf(stderr, "Can't supervise\n");
+        return -1;
+    }
+
+    /* Script exits are taken from a signalfd, SIGCHLD has to be blocked
+     * before any thread starts so none of them takes it instead
+     */
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &sigs, NULL);
+    sigfd = signalfd(-1, &sigs, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    log_start();
     do_log("Starting: " PROG ", version " VERSION);
 
-    /* Opens the /dev/irlp-port device, read/write. This is the communication
-     * Channel to the IRLP hardware from the software 
+    /* Start the flight recorder, we carry on without it if need be */
+    now = dnow();
+    rec_time((uint64_t)(now * 1000));
+    if (strcmp(recfile, "none") && rec_open(recfile) < 0)
+        do_log("Flight recorder disabled");
+
+    /* Resume from the state the last controller left if it is recent */
+    if (strcmp(statefile, "none") && state_open(statefile) < 0)
+        do_log("State file disabled");
+    saved = state_last(now);
+    if (handoff != NULL && (saved == NULL ||
+            handoff->save.saved >= saved->saved))
+        saved = &handoff->save;
+
+    /* Opens the parallel port devices, read/write. This is the communication
+     * Channel to the IRLP hardware from the software. GPIO outputs start
+     * as the saved state left them, so a resumed transmitter doesn't drop.
      */
-    if(irlpdev_open() < 0 ) { 
-        fprintf(stderr, "Can't access parallel port"); 
-        exit(-1); 
-    } 
+    for (i = 0; i < nrpts; ++i) {
+        if ((ps = saved_port(saved, rpts[i].port.name)) != NULL)
+            rpts[i].port.dev.seed = ps->out & rpt_outs(&rpts[i]);
+        for (n = 0; handoff != NULL && n < (int)handoff->save.nports; ++n)
+            if (!strcmp(handoff->save.port[n].name, rpts[i].port.name)) {
+                irlpdev_adopt(&rpts[i].port.dev, hofds[2 + n]);
+                hofds[2 + n] = -1;
+                break;
+            }
+        if(irlpdev_open(&rpts[i].port.dev) < 0 ) { 
+            fprintf(stderr, "Can't access parallel port %s",
+                    rpts[i].port.dev.path); 
+            exit(-1); 
+        } 
+        rpts[i].port.dev.seed = 0;      /* Reopened after an outage */
+    }
+
+    for (n = 0; handoff != NULL && n < (int)handoff->save.nports; ++n)
+        if (hofds[2 + n] >= 0)
+            close(hofds[2 + n]);    /* A port we no longer drive */
+
+    /* Publish our counters */
+    shared = stats_open();
+    counters = *shared;
+    stats = &counters;
+    stats->nports = nrpts;
+    stats->started = now;
+    sampler_init(&sampler, conf.fastpoll, conf.idlepoll, conf.polldecay,
+                 stats->sample);
+    stats->fastms = sampler.fast;
+    stats->idlems = sampler.idle;
+
+    if (handoff != NULL && saved != &handoff->save)
+        handoff = NULL;         /* A respawn after we took over */
 
     /* Sets default settings for the main variables */
-    tim.tv_sec = 0;
-    tim.tv_nsec = 5000000;
+    for (i = 0; i < nrpts; ++i) {
+        rpt_init(&rpts[i]);
+        rpts[i].st = &stats->port[i];
+        if ((ps = saved_port(saved, rpts[i].port.name)) != NULL) {
+            rpt_restore(&rpts[i], ps, handoff != NULL);
+            snprintf(buf, sizeof(buf), "%s: %s from %.0f ms ago",
+                     rpts[i].port.name, handoff ? "Taken over" : "Resumed",
+                     now - saved->saved);
+            do_log(buf);
+        } else {
+            rpts[i].keyflag = unkey(&rpts[i].port);
+            rpts[i].muteflag = mute(&rpts[i].port);
+        }
+        snprintf(rpts[i].st->name, sizeof(rpts[i].st->name), "%s",
+                 rpts[i].port.name);
+        rpts[i].hist = *rpts[i].st;     /* Restored usage is in already */
+        health_init(&rpts[i].health, rpts[i].st);
+        rpts[i].port.dev.quiet = 1;
+    }
 
-    keyflag = unkey(irlpdev);
-    muteflag = mute(irlpdev);
+    /* Keep the usage history */
+    if (strcmp(histfile, "none") && hist_open(histfile) < 0)
+        do_log("Usage history disabled");
+    for (i = 0; i < nrpts; ++i)
+        hist_port(i, rpts[i].port.name);
 
-    /* Just loop forever now */
-    while (1) {
+    /* Watch the loop, the watchdog has handles of its own */
+    for (i = 0; i < nrpts; ++i)
+        if (wd_add(&rpts[i].port) < 0)
+            fprintf(stderr, "No watchdog for %s\n", rpts[i].port.name);
+    if (wd_start(conf.stalltime) < 0)
+        do_log("Watchdog disabled");
 
-        /*
-         * Get input
-         */
+    /* Drive the PWM pins, again through handles of their own */
+    for (i = 0; i < nrpts; ++i) {
+        memset(&rpts[i].st->pwm, 0, sizeof(rpts[i].st->pwm));
+        if (rpts[i].port.pwm.pin && pwm_add(&rpts[i].port,
+                                            &rpts[i].st->pwm) < 0)
+            fprintf(stderr, "No PWM for %s\n", rpts[i].port.name);
+    }
+    if (pwm_start() < 0)
+        do_log("PWM disabled");
 
-        /* Reads the input and output bit from the port */
-        if (read_irlpdev(c, 2) != 2)
-            fprintf(stderr, "Can't read parallel port");
+    /* Key the beacons, also through handles of their own */
+    for (i = 0; i < nrpts; ++i) {
+        memset(&rpts[i].st->beacon, 0, sizeof(rpts[i].st->beacon));
+        if (rpts[i].port.beacon.pin && beacon_add(&rpts[i].port,
+                                                  &rpts[i].st->beacon) < 0)
+            fprintf(stderr, "No beacon for %s\n", rpts[i].port.name);
+    }
+    if (beacon_start() < 0)
+        do_log("Beacon disabled");
 
-        /* Determines the status of various inputs and outputs from the port */
-        COS = (c[0] >> 7) & 0x01;
-        dtmf = (c[0] >> 3) & 0x0f;
-        irlpkey = c[1] & 0x02;
+    /* Read the configuration again when asked or when it changes */
+    signal(SIGHUP, sighup);
+    signal(SIGTERM, sigterm);
+    signal(SIGINT, sigterm);
+    conffd = conf_watch(conffile);
 
-        /*
-         * FAN control
-         */
-        
-        /* This controles the fan. If the radio has been keyed we turn on
-         * the fan.
-         */
-        if (keyflag && !fanflag) {
-            fanflag = fanon(irlpdev);
-        }
-        /* Unkey 5 minutes (300,000 ms) after transmitter dropped */
-        if (!keyflag && fanflag && dnow() - fantimer > FANDELAY) {
-            fanflag = fanoff(irlpdev);
-        }
-        /* fantimer is being set as long as we are keyed */
-        if (keyflag) {
-            fantimer = dnow();
-        }
-        
-        /*
-         * MUTE control
-         */
-        
-        /* This sets the muter, muteflag, and mutetimer when DTMF is detected
-         * It also resets the mute if no DTMF is present, and the timer has 
-         * elapsed.
-         */
-        if (COS) {
-            if (dtmf >= 1 && dtmf <= 17) {
-                if (!muteflag)
-                    muteflag = mute(irlpdev);
-                mutetimer = dnow();
-            } else {
-                if (muteflag) {
-                    if (((dnow() - mutetimer) > MUTETIME) && muteflag)
-                        muteflag = unmute(irlpdev);
-                }
-            }
-        }
+    /* Announcements are played by the controller, not from cron */
+    rpt_schedule(schedfile);
+    schedfd = conf_watch(schedfile);
 
-        /* This mutes repeated audio if there is no COS */
-        if (!COS && !muteflag) {
-            muteflag = mute(irlpdev);
-        }
-       
-        /*
-         * Events that KEY
-         */
-        
-        /* This is the start of the hangtimer. It detects COS and determines 
-         * whether to key up or reset the hangtimer, depending on keyflag. 
-         * Embedded is also the timer for the shortkey system 
-         */
-        if (COS) {
-            if (!keyflag) {
-                keyflag = keyup(irlpdev);
-                shortkeytimer = dnow();
-            }
-            hangtimer = dnow();
-            cttimer = dnow();
-            ctflag = 0;
-            idflag = 0;
+    /* Let other tools drive the ports through us */
+    if (ctlfd < 0 && strcmp(ctlpath, "none") &&
+            (ctlfd = ctl_open(ctlpath)) < 0)
+        do_log("Control socket disabled");
+
+    /* Just loop until told to stop, every port is serviced once per pass */
+    last = dnow();
+    while (!quit) {
+        now = dnow();
+        rec_time((uint64_t)(now * 1000));
+        wd_beat();
+
+        sampler_wake(&sampler, now);
+        gap = (now - last) * 1000;
+        if (gap > stats->maxgapus)
+            stats->maxgapus = gap;
+        if (gap > (sampler.period + LATETIME) * 1000) {
+            stats->overruns++;
+            stats->stallhist[stall_bucket(gap)]++;
         }
-        /* Determines if the IRLP software has keyed the radio, and sets the 
-         * hangtimer, and keys up the radio. 
-         */
-        if (irlpkey) {
-            if (!keyflag) {
-                keyflag = keyup(irlpdev);
-                shortkeytimer = dnow();
-            }
-            hangtimer = dnow();
-            cttimer = dnow();
-            irlpflag = 1;
-            idflag = 0;
-        }
-        /* The forcekeyflag does just that, keys programmatically */
-        if(forcekeyflag) {
-            if (!keyflag) {
-                keyflag = keyup(irlpdev);
-                shortkeytimer = dnow();
+        stats->loops++;
+        last = now;
+
+        /* The watchdog stepped in, our flags follow what it did */
+        if ((stall = wd_tripped()) > 0) {
+            stats->wdtrips++;
+            for (i = 0; i < nrpts; ++i) {
+                rpts[i].keyflag = rpt_out(&rpts[i], "unkey", OFF);
+                rpts[i].muteflag = rpt_out(&rpts[i], "mute", ON);
             }
-            hangtimer = dnow();
+            snprintf(buf, sizeof(buf), "Watchdog: loop back after %d ms",
+                     stall);
+            do_log(buf);
         }
 
-        /*
-         * Shortkey feature
-         */
+        /* Account scripts that ended before anything else sees it */
+        if (sigfd < 0 || chld) {
+            chld = 0;
+            reap_scripts();
+        }
 
-        /* Once the shortkey timer is exceeded, it stops the shortkey 
-         * features from unkeying the radio.
-         */
-        if (COS || irlpkey || forcekeyflag) { 
-            if (!shortkeyflag && dnow() - shortkeytimer > SHORTKEY) {
-                do_log("Shortkey exceeded");
-                shortkeyflag = 1;
-            }
+        /* Configuration changes take effect between passes */
+        if ((conffd >= 0 && conf_changed(conffd, conffile)) || reload) {
+            rpt_reload(conffile);
+            wd_budget(conf.stalltime);
         }
+        if ((schedfd >= 0 && conf_changed(schedfd, schedfile)) || reload)
+            rpt_schedule(schedfile);
+        reload = 0;
 
-        /*
-         * Play the courtesy tone
-         */
+        /* Announcements that fell due wait with their ports */
+        while ((n = cal_pop(&cal, (time_t)(now / 1000))) >= 0)
+            for (i = 0; i < nrpts; ++i)
+                if (!strcmp(cal.rule[n].port, "*") ||
+                        !strcmp(cal.rule[n].port, rpts[i].port.name))
+                    rpt_announce(&rpts[i], cal.rule[n].msg);
 
-        /* Once COS is dropped, and the cttimer is exceeded, we play the 
-         * courtesy tone. Do not CT over ID. 
-         */
-        if (!COS && !irlpkey && !idbusy) {
-            /* If IRLP was last to drop cttimer is shorter because IRLP
-             * has a longer delay before unkey
-             */
-            if (!ctflag && !ctpid && irlpflag && dnow() - cttimer > CTTIMEI) {
-                do_ct(&ctpid);
-                ctbusy = 1;
-                forcekeyflag = 1;
-            }
-            /* If COS was last to drop cttimer is longer */
-            if (!ctflag && !ctpid && !irlpflag && dnow() - cttimer > CTTIME) {
-                do_ct(&ctpid);
-                ctbusy = 1;
-                forcekeyflag = 1;
+        /* Control requests change state ahead of the pass */
+        nctl = 0;
+        while (ctlfd >= 0 && nctl < CTLQUEUE && ctl_recv(ctlfd, &ctl[nctl])) {
+            if (!strncmp(ctl[nctl].buf, "handoff", 7)) {
+                /* Requests taken ahead of it are written out and answered
+                 * first, the taker gets pins that agree with the flags
+                 */
+                n = nctl;
+                for (i = 0; nctl && i < nrpts; ++i)
+                    if (!rpts[i].health.down)
+                        rpt_flush(&rpts[i], now);
+                for (i = 0; i < nctl; ++i) {
+                    rpt_status(ctlrpt[i], reply, sizeof(reply));
+                    ctl_reply(ctlfd, &ctl[i], reply);
+                }
+                nctl = 0;
+                if ((handed = rpt_handoff(ctlfd, pidfd, &ctl[n])))
+                    break;
+                continue;
             }
+            ctlrpt[nctl] = ctl_apply(ctlfd, &ctl[nctl], now);
+            if (ctlrpt[nctl] != NULL)
+                ++nctl;
         }
-        /* Handle forked child script */
-        check_script(&ctpid);
-        if (!ctpid && ctbusy && forcekeyflag) {
-            ctbusy = 0;
-            ctflag = 1;
-            forcekeyflag = 0;
-        }
+        if (handed)
+            break;
 
-        /*
-         * Play the ID
-         *
-         * The idflag is cleared by keyup and set upon playing of ID. We
-         * cannot use the keyfkag in its case because the keyup to play
-         * ID would then trigger the ID requirement causing an endless loop.
-         *
-         * The idbusy flag is required to properly detect end of script
-         * execution and setting and clearing of flags associated with that
-         * event. It ensure this is a one shot event at the end of script
-         * execution.
-         *
-         * The idstate is more then just true or false here. We track the
-         * following states
-         *
-         *      0   idle
-         *      1   immediate ID pending
-         *      2   delayed ID pending
-         *      3   ID played
-         */
+        PROBE2(repeater, tick_start, stats->loops, (uint64_t)gap);
+        for (i = 0; i < nrpts; ++i)
+            rpt_tick(&rpts[i], now);
+        PROBE2(repeater, tick_end, stats->loops,
+               (uint64_t)((dnow() - now) * 1000));
 
-        /* ID requirement from idle */
-        if (idstate == 0 && !idflag) {
-            idstate = 1;
-            idtimer = dnow();
-            do_log("ID: immediate");
-        }
-        /* Repeated ID requirement */
-        if (idstate == 3 && !idflag) {
-            idstate = 2;
-            //idtimer = dnow();
-            do_log("ID: delayed");
-        }
-        /* Immediate ID required */
-        if (idstate == 1 && !idpid) {
-            /* Tuck behind courtesy tone */
-            if (!COS && !irlpkey && keyflag && ctflag) {
-                do_id(&idpid);
-                idbusy = 1;
-                forcekeyflag = 1;
-                idtimer = dnow();
-            }
-            /* ID if we timeout */
-            if (dnow() - idtimer > IDWAIT) {
-                do_id(&idpid);
-                idbusy = 1;
-                forcekeyflag = 1;
-                idtimer = dnow();
-            }
+        /* Sample fast while anything happens or a timer is about to */
+        active = 0;
+        due = -1;
+        for (i = 0; i < nrpts; ++i) {
+            active |= rpt_active(&rpts[i]);
+            d = rpt_due(&rpts[i], now);
+            if (d >= 0 && (due < 0 || d < due))
+                due = d;
         }
-        /* Delayed ID required */
-        if (idstate == 2 && !idpid) {
-            /* Tuck behind courtesy tone */
-            if (!COS && !irlpkey && keyflag && ctflag && 
-                    dnow() - idtimer > IDPERIOD) {
-                do_id(&idpid);
-                idbusy = 1;
-                forcekeyflag = 1;
-                idtimer = dnow();
-            }
-            /* ID if we timeout */
-            if (dnow() - idtimer > IDPERIOD + IDWAIT) {
-                do_id(&idpid);
-                idbusy = 1;
-                forcekeyflag = 1;
-                idtimer = dnow();
-            }
+        d = cal_due(&cal, now);
+        if (d >= 0 && (due < 0 || d < due))
+            due = d;
+        for (i = 0; i < nexits; ++i) {
+            d = exits[i].at + conf.idkeydly - now;
+            if (d > 0 && (due < 0 || d < due))
+                due = d;
         }
-        /* Reset ID */
-        if (idstate == 3 && dnow() - idtimer > IDPERIOD + IDWAIT) {
-            idstate = 0;
-            do_log("ID: reset");
+        wait = sampler_next(&sampler, now, active, due);
+        stats->period = wait;
+        stats_commit(shared, stats);
+
+        /* Keep the state for a restart, in memory only */
+        if ((saved = state_next()) != NULL) {
+            saved->nports = nrpts;
+            for (i = 0; i < nrpts; ++i)
+                rpt_save(&rpts[i], &saved->port[i]);
+            state_commit(now);
         }
 
-        /* Handle forked child script */
-        check_script(&idpid);
-        if (!idpid && idbusy && forcekeyflag) {
-            idbusy = 0;
-            idflag = 1;
-            idstate = 3;
-            forcekeyflag = 0;
+        /* Add the usage to the history once a second */
+        if (time(NULL) != histsec) {
+            histsec = time(NULL);
+            for (i = 0; i < nrpts; ++i)
+                rpt_history(&rpts[i], i, histsec);
         }
-        
-        /*
-         * Events that UNKEY
-         */
 
-        /* If the shortkey timer has not been exceeded, and COS is dropped, 
-         * we drop the transmitter. It also makes sure there is no courtesy 
-         * tones. 
-         */
-        if (!COS && !irlpkey && !forcekeyflag && keyflag && !shortkeyflag) {
-            keyflag = unkey(irlpdev);
-            ctflag = 1;
-            idflag = 1;
-            irlpflag = 0;
-            shortkeyflag = 0;
-        }
-        /* When the hangtime is exceeded, the radio is unkeyed, and the 
-         * shortkeytimer is reset. 
-         */
-        if (!COS && !irlpkey && !forcekeyflag && 
-                keyflag && (dnow() - hangtimer > HANGTIME)) {
-            keyflag = unkey(irlpdev);
-            irlpflag = 0;
-            shortkeyflag = 0;
+        /* And are answered with the state the pass left behind */
+        for (i = 0; i < nctl; ++i) {
+            rpt_status(ctlrpt[i], reply, sizeof(reply));
+            ctl_reply(ctlfd, &ctl[i], reply);
         }
 
         /*
          * Miscellaneous loop tasks
          */
 
-        fflush(stdout);
-        fflush(stderr);
-
         /* This is a delay timer to keep this from sucking 100% processor, 
-         * important in any loop. 
+         * important in any loop. A script exit, a control request or a
+         * GPIO edge cuts it short.
          */
-        nanosleep(&tim, NULL);
+        n = 0;
+        if (sigfd >= 0) {
+            pfd[n].fd = sigfd;
+            pfd[n++].events = POLLIN;
+        }
+        if (ctlfd >= 0) {
+            pfd[n].fd = ctlfd;
+            pfd[n++].events = POLLIN;
+        }
+        for (i = 0; i < nrpts; ++i) {
+            if ((pfd[n].fd = irlpdev_evfd(&rpts[i].port.dev)) >= 0)
+                pfd[n++].events = POLLIN;
+        }
+        poll(pfd, n, wait);
+        if (sigfd >= 0 && (pfd[0].revents & POLLIN)) {
+            while (read(sigfd, &si, sizeof(si)) == sizeof(si))
+                ;
+            chld = 1;
+        }
+    }
+
+    /* The new controller carries on with the ports, leave them be. Requests
+     * after the handoff wait in the socket for it.
+     */
+    if (handed) {
+        wd_stop();
+        rec_close();
+        state_close();
+        hist_close();
+        log_stop();
+        return HANDOFFEXIT;
     }
-}
 
+    /* Leave the transmitter in a safe state on the way out */
+    do_log("Stopping: " PROG);
+    wd_stop();
+    pwm_stop();
+    beacon_stop();
+    for (i = 0; i < nrpts; ++i) {
+        if (rpts[i].ctpid)
+            kill(-rpts[i].ctpid, SIGTERM);
+        if (rpts[i].idpid)
+            kill(-rpts[i].idpid, SIGTERM);
+        if (rpts[i].anpid)
+            kill(-rpts[i].anpid, SIGTERM);
+        rpt_safe(&rpts[i]);
+    }
+    ctl_close(ctlfd, ctlpath);
+    stats_close();
+    rec_close();
+    state_close();
+    hist_close();
+    log_stop();
+    return 0;
+}
@@ -29,7 +29,7 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-#define VERSION     "20130112"
+#define VERSION     "20261019"
 
 /* The parallel port input pins
  * 
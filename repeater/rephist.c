@@ -0,0 +1,183 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "history.h"
+
+static char *usage =
+    "Usage: rephist [OPTION]\n"
+    "Show the repeater usage history.\n"
+    "   -f      history FILE, default " HISTFILE "\n"
+    "   -t      buckets of TIER [minute|hour|day], default hour\n"
+    "   -p      only the port NAME\n"
+    "   -n      the last NUMBER of buckets, default a day's worth\n"
+    "   -s      only show the totals\n"
+    "   -c      export as comma separated values\n"
+    "   -h      display this help and exit\n"
+    "Copyright (c) 2026, Adi Linden <adi@adis.ca>\n";
+
+static char *tiers[HISTTIERS] = { "minute", "hour", "day" };
+static uint32_t spans[HISTTIERS] = { 60, 24, 31 };
+
+int main(int argc, char *argv[])
+{
+    char *file = HISTFILE;
+    char *name = NULL;
+    struct histhdr *h;
+    uint32_t *stamp, *col[HISTPORTS][HISTMETRICS];
+    uint64_t total[HISTMETRICS];
+    uint32_t now, first, b, i;
+    int csv = 0, sum = 0, tier = HIST_HOUR;
+    int port, m, n = 0, rows = 0;
+    char ts[40];
+    time_t sec;
+
+    /* Get any optional command line args (start with -) */
+    while (argc > 1 && *argv[1] == '-') {
+        if (!strcmp(argv[1], "-c")) {
+            csv = 1;
+        }
+        if (!strcmp(argv[1], "-s")) {
+            sum = 1;
+        }
+        if (!strcmp(argv[1], "-h")) {
+            fprintf(stderr, usage);
+            return -1;
+        }
+        if (!strcmp(argv[1], "-f") && argc > 2) {
+            file = argv[2];
+            argc -= 1;
+            argv += 1;
+        }
+        if (!strcmp(argv[1], "-p") && argc > 2) {
+            name = argv[2];
+            argc -= 1;
+            argv += 1;
+        }
+        if (!strcmp(argv[1], "-n") && argc > 2) {
+            n = atoi(argv[2]);
+            argc -= 1;
+            argv += 1;
+        }
+        if (!strcmp(argv[1], "-t") && argc > 2) {
+            for (tier = 0; tier < HISTTIERS; ++tier)
+                if (!strcmp(argv[2], tiers[tier]))
+                    break;
+            if (tier == HISTTIERS) {
+                fprintf(stderr, "Unknown tier %s\n", argv[2]);
+                return -1;
+            }
+            argc -= 1;
+            argv += 1;
+        }
+        argc -= 1;
+        argv += 1;
+    }
+
+    /* Map the history read only, the controller may be writing it */
+    if ((h = hist_map(file)) == NULL) {
+        fprintf(stderr, "Can't map history %s\n", file);
+        return -1;
+    }
+    for (port = 0; port < (int)h->nports; ++port)
+        if (name == NULL || !strcmp(name, h->name[port]))
+            break;
+    if (port == (int)h->nports) {
+        fprintf(stderr, "No port %s in %s\n", name ? name : "at all", file);
+        return -1;
+    }
+
+    /* The columns to scan, all ports are added up unless one is asked for */
+    stamp = hist_stamps(h, tier);
+    for (i = 0; i < h->nports; ++i)
+        for (m = 0; m < HISTMETRICS; ++m)
+            col[i][m] = hist_column(h, tier, i, m);
+    if (n <= 0)
+        n = spans[tier];
+    if ((uint32_t)n > h->tier[tier].slots)
+        n = h->tier[tier].slots;
+
+    now = time(NULL) / h->tier[tier].step;
+    first = now - n + 1;
+    memset(total, 0, sizeof(total));
+
+    if (csv && !sum)
+        printf("time,tx_ms,keyups,irlp_ms,fan_ms\n");
+    for (b = first; b <= now; ++b) {
+        uint64_t v[HISTMETRICS] = { 0, 0, 0, 0 };
+
+        i = b % h->tier[tier].slots;
+        if (stamp[i] != b)
+            continue;
+        for (port = 0; port < (int)h->nports; ++port) {
+            if (name != NULL && strcmp(name, h->name[port]))
+                continue;
+            for (m = 0; m < HISTMETRICS; ++m)
+                v[m] += col[port][m][i];
+        }
+        for (m = 0; m < HISTMETRICS; ++m)
+            total[m] += v[m];
+        ++rows;
+        if (sum)
+            continue;
+
+        sec = (time_t)b * h->tier[tier].step;
+        if (csv) {
+            printf("%lld,%llu,%llu,%llu,%llu\n", (long long)sec,
+                   (unsigned long long)v[HM_TX],
+                   (unsigned long long)v[HM_KEYUPS],
+                   (unsigned long long)v[HM_IRLP],
+                   (unsigned long long)v[HM_FAN]);
+            continue;
+        }
+        strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M", localtime(&sec));
+        printf("%s  tx %9.1f s  keyups %6llu  irlp %9.1f s  fan %9.1f s\n",
+               ts, v[HM_TX] / 1000.0, (unsigned long long)v[HM_KEYUPS],
+               v[HM_IRLP] / 1000.0, v[HM_FAN] / 1000.0);
+    }
+
+    if (csv) {
+        if (sum)
+            printf("%llu,%llu,%llu,%llu\n",
+                   (unsigned long long)total[HM_TX],
+                   (unsigned long long)total[HM_KEYUPS],
+                   (unsigned long long)total[HM_IRLP],
+                   (unsigned long long)total[HM_FAN]);
+        return 0;
+    }
+    printf("%-16s  tx %9.1f s  keyups %6llu  irlp %9.1f s  fan %9.1f s\n",
+           "Total", total[HM_TX] / 1000.0, (unsigned long long)total[HM_KEYUPS],
+           total[HM_IRLP] / 1000.0, total[HM_FAN] / 1000.0);
+    printf("%d of the last %d %ss with data\n", rows, n, tiers[tier]);
+    return 0;
+}
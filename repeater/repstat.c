@@ -0,0 +1,282 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include "stats.h"
+#include "portlock.h"
+
+static char *usage =
+    "Usage: repstat [OPTION]\n"
+    "Show the live counters of the running repeater.\n"
+    "   -i      repeat every SECONDS\n"
+    "   -c      comma separated values\n"
+    "   -p      show the shared port lock of DEVICE instead\n"
+    "   -h      display this help and exit\n"
+    "Copyright (c) 2026, Adi Linden <adi@adis.ca>\n";
+
+void print_stats(struct stats *st, int csv);
+void print_script(char *name, struct scriptstats *ss, uint64_t runs);
+void print_sampling(struct stats *st);
+int show_lock(char *path, struct timespec *tim, double interval);
+
+int main(int argc, char *argv[])
+{
+    struct stats *s;
+    struct stats st;
+    struct timespec tim;
+    double interval = 0;
+    char *lockdev = NULL;
+    int csv = 0;
+
+    /* Get any optional command line args (start with -) */
+    while (argc > 1 && *argv[1] == '-') {
+        if (!strcmp(argv[1], "-c")) {
+            csv = 1;
+        }
+        if (!strcmp(argv[1], "-h")) {
+            fprintf(stderr, usage);
+            return -1;
+        }
+        if (!strcmp(argv[1], "-p") && argc > 2) {
+            lockdev = argv[2];
+            argc -= 1;
+            argv += 1;
+        }
+        if (!strcmp(argv[1], "-i") && argc > 2) {
+            interval = atof(argv[2]);
+            argc -= 1;
+            argv += 1;
+        }
+        argc -= 1;
+        argv += 1;
+    }
+
+    tim.tv_sec = interval;
+    tim.tv_nsec = (interval - tim.tv_sec) * 1000000000;
+    if (lockdev != NULL)
+        return show_lock(lockdev, &tim, interval);
+
+    s = stats_map();
+    if (s == NULL) {
+        fprintf(stderr, "No repeater running\n");
+        return -1;
+    }
+    if (kill(s->pid, 0) < 0 && errno == ESRCH)
+        fprintf(stderr, "Repeater not running, showing its last counters\n");
+
+    if (csv)
+        printf("time,port,keyups,kerchunks,tx,irlp,local,cts,ids,fan,"
+               "loops,overruns,maxgap,wdtrips\n");
+    do {
+        if (stats_read(s, &st) < 0)
+            fprintf(stderr, "Counters caught mid update, may be torn\n");
+        print_stats(&st, csv);
+        fflush(stdout);
+    } while (interval > 0 && !nanosleep(&tim, NULL));
+
+    return 0;
+}
+
+void print_stats(struct stats *st, int csv)
+{
+    struct portstats *p;
+    time_t now = time(NULL);
+    int i, ms;
+
+    for (i = 0; i < st->nports && i < STATPORTS; ++i) {
+        p = &st->port[i];
+        if (csv) {
+            printf("%ld,%s,%llu,%llu,%.3f,%.3f,%.3f,%llu,%llu,%.3f,"
+                   "%llu,%llu,%.3f,%llu\n",
+                   (long)now, p->name,
+                   (unsigned long long)p->keyups,
+                   (unsigned long long)p->kerchunks,
+                   p->txus / 1e6, p->irlpus / 1e6, p->localus / 1e6,
+                   (unsigned long long)p->cts, (unsigned long long)p->ids,
+                   p->fanus / 1e6,
+                   (unsigned long long)st->loops,
+                   (unsigned long long)st->overruns, st->maxgapus / 1e3,
+                   (unsigned long long)st->wdtrips);
+            continue;
+        }
+        printf("%s: keyups %llu kerchunks %llu tx %.1fs (irlp %.1fs local %.1fs)"
+               " ct %llu id %llu fan %.1fs\n",
+               p->name,
+               (unsigned long long)p->keyups,
+               (unsigned long long)p->kerchunks,
+               p->txus / 1e6, p->irlpus / 1e6, p->localus / 1e6,
+               (unsigned long long)p->cts, (unsigned long long)p->ids,
+               p->fanus / 1e6);
+        if (p->cosglitches || p->dtmfglitches)
+            printf("  glitches: cos %llu dtmf %llu\n",
+                   (unsigned long long)p->cosglitches,
+                   (unsigned long long)p->dtmfglitches);
+        if (p->porterrors || p->outages)
+            printf("  port: errors %llu outages %llu recoveries %llu"
+                   " down %.1fs max %.1fs%s\n",
+                   (unsigned long long)p->porterrors,
+                   (unsigned long long)p->outages,
+                   (unsigned long long)p->recoveries,
+                   p->downus / 1e6, p->maxdownus / 1e6,
+                   p->downsince ? ", out of service now" : "");
+        if (p->pwm.hz) {
+            printf("  pwm: %uHz duty %.1f%% edges %llu late avg %.0fus "
+                   "max %lluus over 1ms %llu held back %llu errors %llu\n",
+                   p->pwm.hz, p->pwm.duty / 10.0,
+                   (unsigned long long)p->pwm.edges,
+                   p->pwm.edges ? (double)p->pwm.lateus / p->pwm.edges : 0,
+                   (unsigned long long)p->pwm.maxlateus,
+                   (unsigned long long)p->pwm.late,
+                   (unsigned long long)p->pwm.deferred,
+                   (unsigned long long)p->pwm.errors);
+            printf("  pwm: key/mute writes %llu took avg %.0fus max %lluus, "
+                   "waited for an edge max %lluus\n",
+                   (unsigned long long)p->pwm.keywrites,
+                   p->pwm.keywrites ?
+                   (double)p->pwm.keyus / p->pwm.keywrites : 0,
+                   (unsigned long long)p->pwm.maxkeyus,
+                   (unsigned long long)p->pwm.maxholdus);
+        }
+        if (p->beacon.wpm)
+            printf("  beacon: %uwpm dit %uus sends %llu edges %llu late avg "
+                   "%.0fus max %lluus over 1ms %llu element error max "
+                   "%lluus errors %llu\n", p->beacon.wpm, p->beacon.unitus,
+                   (unsigned long long)p->beacon.sends,
+                   (unsigned long long)p->beacon.edges,
+                   p->beacon.edges ?
+                   (double)p->beacon.lateus / p->beacon.edges : 0,
+                   (unsigned long long)p->beacon.maxlateus,
+                   (unsigned long long)p->beacon.late,
+                   (unsigned long long)p->beacon.maxerrus,
+                   (unsigned long long)p->beacon.errors);
+        print_script("ct", &p->ct, p->cts);
+        print_script("id", &p->id, p->ids);
+        print_script("an", &p->an, p->anns);
+    }
+    if (!csv)
+        printf("pid %d up %llus loops %llu overruns %llu max gap %.1fms\n",
+               (int)st->pid,
+               (unsigned long long)(now - st->started / 1000),
+               (unsigned long long)st->loops,
+               (unsigned long long)st->overruns, st->maxgapus / 1e3);
+    if (!csv)
+        print_sampling(st);
+    if (csv || !st->overruns)
+        return;
+
+    /* Late passes by how late they were */
+    printf("late passes:");
+    for (i = 0, ms = STALLBASE; i < STALLBUCKETS; ++i, ms *= 2)
+        if (st->stallhist[i])
+            printf(" %s%dms %llu", i == STALLBUCKETS - 1 ? ">=" : "<",
+                   i == STALLBUCKETS - 1 ? ms : ms * 2,
+                   (unsigned long long)st->stallhist[i]);
+    printf(" watchdog trips %llu\n", (unsigned long long)st->wdtrips);
+}
+
+void print_script(char *name, struct scriptstats *ss, uint64_t runs)
+{
+    if (!runs)
+        return;
+    printf("  %s: failed %llu last exit %lld ran %.1fms avg %.1fms "
+           "max %.1fms to unkey %.1fms max %.1fms\n", name,
+           (unsigned long long)ss->fails, (long long)ss->lastexit,
+           ss->lastus / 1e3, ss->totalus / 1e3 / runs, ss->maxus / 1e3,
+           ss->unkeyus / 1e3, ss->maxunkeyus / 1e3);
+}
+
+/* Wakeups per second and worst edge detection latency of each mode */
+void print_sampling(struct stats *st)
+{
+    static char *modes[SAMPLEMODES] = { "fast", "decay", "idle" };
+    struct samplestats *m;
+    int i;
+
+    printf("sampling %ums (fast %ums idle %ums):", st->period, st->fastms,
+           st->idlems);
+    for (i = 0; i < SAMPLEMODES; ++i) {
+        m = &st->sample[i];
+        if (!m->us)
+            continue;
+        printf(" %s %.0f%% %.1f/s worst %.1fms", modes[i],
+               100.0 * m->us / (st->sample[0].us + st->sample[1].us +
+                                st->sample[2].us),
+               m->wakeups * 1e6 / m->us, m->maxlatus / 1e3);
+    }
+    printf("\n");
+}
+
+/*
+ * Who holds the port and how long everyone waited for it. The segment
+ * changes under us, the figures are only as consistent as a glance.
+ */
+int show_lock(char *path, struct timespec *tim, double interval)
+{
+    struct portlock *l;
+    struct timespec ts;
+    uint64_t now, claims;
+
+    l = portlock_map(path);
+    if (l == NULL) {
+        fprintf(stderr, "No shared port lock for %s\n", path);
+        return -1;
+    }
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        now = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+        claims = l->claims ? l->claims : 1;
+        if (l->holder)
+            printf("%s: held by %d (%.16s) for %.1fms\n", path,
+                   (int)l->holder, l->comm,
+                   now > l->since ? (now - l->since) / 1e3 : 0.0);
+        else
+            printf("%s: free\n", path);
+        printf("  claims %llu contended %llu wait avg %.3fms max %.1fms "
+               "(%.16s behind %.16s)\n",
+               (unsigned long long)l->claims,
+               (unsigned long long)l->contended,
+               l->contended ? l->waitus / 1e3 / l->contended : 0.0,
+               l->maxwaitus / 1e3, l->maxwaiter, l->maxblocker);
+        printf("  hold avg %.3fms max %.1fms (%.16s) holders died %llu",
+               l->holdus / 1e3 / claims, l->maxholdus / 1e3, l->maxholder,
+               (unsigned long long)l->deaths);
+        if (l->deaths)
+            printf(" last %d", (int)l->lastdead);
+        printf("\n");
+        fflush(stdout);
+    } while (interval > 0 && !nanosleep(tim, NULL));
+    return 0;
+}
@@ -0,0 +1,120 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include "stats.h"
+#include "sampler.h"
+
+/* Counters of a sampler nobody reports on */
+static struct samplestats unused[SAMPLEMODES];
+
+void sampler_init(struct sampler *s, int fast, int idle, int decay,
+                  struct samplestats *st)
+{
+    sampler_set(s, fast, idle, decay);
+    s->period = s->fast;
+    s->mode = SAMPLE_FAST;
+    s->active = 0;
+    s->last = 0;
+    s->prev = 0;
+    s->st = st ? st : unused;
+}
+
+/*
+ * Change the periods, they apply from the next sleep on
+ */
+void sampler_set(struct sampler *s, int fast, int idle, int decay)
+{
+    s->fast = fast > 0 ? fast : 1;
+    s->idle = idle > s->fast ? idle : s->fast;
+    s->decay = decay;
+}
+
+/*
+ * A sleep ended, times in ms like dnow()
+ */
+void sampler_wake(struct sampler *s, double now)
+{
+    struct samplestats *m = &s->st[s->mode];
+
+    m->wakeups++;
+    if (s->last > 0 && now > s->last)
+        m->us += (now - s->last) * 1000;
+    s->prev = s->last;
+    s->last = now;
+}
+
+/*
+ * An input changed. Unless we know when, it may have changed right after
+ * the previous wakeup.
+ */
+void sampler_edge(struct sampler *s, double now, double at)
+{
+    struct samplestats *m = &s->st[s->mode];
+    uint64_t us;
+
+    if (s->prev <= 0)
+        return;                 /* The first sample, no edge to time */
+    if (at < s->prev)
+        at = s->prev;
+    us = now > at ? (now - at) * 1000 : 0;
+    m->edges++;
+    if (us > m->maxlatus)
+        m->maxlatus = us;
+}
+
+/*
+ * The next sleep in ms. Active is set while inputs or outputs are on, due
+ * is the time to the nearest timer or negative if none is running.
+ */
+int sampler_next(struct sampler *s, double now, int active, double due)
+{
+    double quiet;
+    int p;
+
+    if (active || (due >= 0 && due < s->period))
+        s->active = now;
+    quiet = now - s->active;
+
+    p = s->fast;
+    if (s->decay > 0)
+        while (quiet >= s->decay && p < s->idle) {
+            quiet -= s->decay;
+            p *= 2;
+        }
+    else if (quiet > 0)
+        p = s->idle;
+    if (p > s->idle)
+        p = s->idle;
+
+    s->period = p;
+    s->mode = p == s->fast ? SAMPLE_FAST :
+              p == s->idle ? SAMPLE_IDLE : SAMPLE_DECAY;
+    return p;
+}
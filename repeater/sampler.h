@@ -0,0 +1,66 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Adaptive sampling
+ *
+ * The inputs are sampled at a high rate while anything happens and at a
+ * low one while the repeater sits idle. Activity, or a timer about to
+ * expire, switches to the fast period at once. Once it is over the
+ * period doubles every decay interval until it is back at the idle one.
+ *
+ * Each sleep is accounted to the mode it was taken in, with the wakeups,
+ * the time spent and the worst time an input edge waited to be seen.
+ */
+
+struct samplestats;             /* See stats.h */
+
+/* Modes, the index into the samplestats */
+#define SAMPLE_FAST     0
+#define SAMPLE_DECAY    1
+#define SAMPLE_IDLE     2
+
+struct sampler {
+    int     fast;               /* Periods and decay interval in ms */
+    int     idle;
+    int     decay;
+    int     period;             /* The sleep being taken */
+    int     mode;               /* and its mode */
+    double  active;             /* Last time something happened */
+    double  last;               /* Last wakeup */
+    double  prev;               /* and the one before */
+    struct samplestats *st;     /* SAMPLEMODES counters */
+};
+
+void sampler_init(struct sampler *s, int fast, int idle, int decay,
+                  struct samplestats *st);
+void sampler_set(struct sampler *s, int fast, int idle, int decay);
+void sampler_wake(struct sampler *s, double now);
+void sampler_edge(struct sampler *s, double now, double at);
+int  sampler_next(struct sampler *s, double now, int active, double due);
@@ -0,0 +1,124 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include "stats.h"
+#include "state.h"
+
+struct statefile {
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    size;           /* Of the whole file, layout check */
+    uint32_t    cur;            /* Slot holding the latest state */
+    struct statesave slot[2];
+};
+
+static struct statefile *sf = NULL;
+
+/*
+ * Map the state file, a file of another layout is started over
+ */
+int state_open(char *path)
+{
+    int fd;
+
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Can't open state %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(struct statefile)) < 0) {
+        fprintf(stderr, "Can't size state %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    sf = mmap(NULL, sizeof(struct statefile), PROT_READ | PROT_WRITE,
+              MAP_SHARED, fd, 0);
+    close(fd);
+    if (sf == MAP_FAILED) {
+        fprintf(stderr, "Can't map state %s: %s\n", path, strerror(errno));
+        sf = NULL;
+        return -1;
+    }
+
+    if (sf->magic != STATEMAGIC || sf->version != STATEVERSION ||
+            sf->size != sizeof(struct statefile) || sf->cur > 1) {
+        memset(sf, 0, sizeof(struct statefile));
+        sf->magic = STATEMAGIC;
+        sf->version = STATEVERSION;
+        sf->size = sizeof(struct statefile);
+    }
+    return 0;
+}
+
+/*
+ * The state the last controller left, NULL if there is none fresh enough
+ */
+struct statesave *state_last(double now)
+{
+    struct statesave *s;
+
+    if (sf == NULL)
+        return NULL;
+    s = &sf->slot[__atomic_load_n(&sf->cur, __ATOMIC_ACQUIRE)];
+    if (s->saved <= 0 || now - s->saved > STATEFRESH || now < s->saved)
+        return NULL;
+    return s;
+}
+
+/*
+ * The slot to fill this pass, NULL without a state file
+ */
+struct statesave *state_next()
+{
+    return sf ? &sf->slot[!sf->cur] : NULL;
+}
+
+/*
+ * The slot is complete, make it the latest
+ */
+void state_commit(double now)
+{
+    if (sf == NULL)
+        return;
+    sf->slot[!sf->cur].saved = now;
+    __atomic_store_n(&sf->cur, !sf->cur, __ATOMIC_RELEASE);
+}
+
+void state_close()
+{
+    if (sf != NULL)
+        munmap(sf, sizeof(struct statefile));
+    sf = NULL;
+}
@@ -0,0 +1,90 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Persistent state
+ *
+ * The timers, flags and outputs of every port and their counters are kept
+ * in a small file mapped into memory, so a restarted controller picks up
+ * where the last one left off: an ID already given is not given again, a
+ * running fan keeps running and the outputs are not forced off and on.
+ *
+ * The file holds two slots. Every pass fills the slot not in use and then
+ * flips to it, all in memory without a system call, so a controller that
+ * dies halfway through a pass leaves the previous slot intact. The page
+ * cache keeps the file across a crash of the process, not across a power
+ * cycle, and a state older than STATEFRESH is not restored.
+ *
+ * Include stats.h first.
+ */
+
+#include <stdint.h>
+
+#define STATEFILE   "/var/tmp/repeater.state"
+#define STATEMAGIC  0x45544153  /* "SATE" */
+#define STATEVERSION 7
+#define STATEFRESH  60000       /* Restore a state at most this old, ms */
+
+/* What a port needs to resume */
+struct portsave {
+    char        name[16];
+    unsigned char out;          /* Data register */
+    int         idstate;
+    int         idflag;
+    int         ctflag;
+    int         keyflag;
+    int         muteflag;
+    int         fanflag;
+    int         irlpflag;
+    int         shortkeyflag;
+    int         ctlkeyflag;     /* Only taken over on a handoff */
+    int         ctlmuteflag;
+    int         pwmflag;
+    double      txduty;         /* Recent transmitter duty cycle */
+    double      mutetimer;      /* Timers, ms since the epoch */
+    double      hangtimer;
+    double      cttimer;
+    double      idtimer;
+    double      shortkeytimer;
+    double      fantimer;
+    struct portstats st;        /* Counters */
+};
+
+struct statesave {
+    double      saved;          /* When, ms since the epoch */
+    uint32_t    nports;
+    uint32_t    pad;
+    struct portsave port[STATPORTS];
+};
+
+int  state_open(char *path);
+struct statesave *state_last(double now);
+struct statesave *state_next();
+void state_commit(double now);
+void state_close();
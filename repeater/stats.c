@@ -0,0 +1,241 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "stats.h"
+
+/* Used when shared memory is not available so callers never check */
+static struct stats local;
+static struct stats *shared = NULL;
+
+/*
+ * Create the segment for the controller. Falls back to process memory.
+ */
+struct stats *stats_open()
+{
+    struct stats *s;
+    int fd;
+
+    memset(&local, 0, sizeof(local));
+    fd = shm_open(STATSHM, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Can't open " STATSHM ": %s\n", strerror(errno));
+        return &local;
+    }
+    if (ftruncate(fd, sizeof(struct stats)) < 0) {
+        fprintf(stderr, "Can't size " STATSHM ": %s\n", strerror(errno));
+        close(fd);
+        return &local;
+    }
+    s = mmap(NULL, sizeof(struct stats), PROT_READ | PROT_WRITE,
+             MAP_SHARED, fd, 0);
+    close(fd);
+    if (s == MAP_FAILED) {
+        fprintf(stderr, "Can't map " STATSHM ": %s\n", strerror(errno));
+        return &local;
+    }
+
+    memset(s, 0, sizeof(struct stats));
+    s->magic = STATMAGIC;
+    s->version = STATVERSION;
+    s->pid = getpid();
+    shared = s;
+    return s;
+}
+
+/*
+ * Map the segment read only for a reader, NULL without a controller
+ */
+struct stats *stats_map()
+{
+    struct stats *s;
+    int fd;
+
+    fd = shm_open(STATSHM, O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+    s = mmap(NULL, sizeof(struct stats), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (s == MAP_FAILED)
+        return NULL;
+    if (s->magic != STATMAGIC || s->version != STATVERSION) {
+        munmap(s, sizeof(struct stats));
+        return NULL;
+    }
+    return s;
+}
+
+void stats_begin(struct stats *s)
+{
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void stats_end(struct stats *s)
+{
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Publish the counters kept in the memory of the controller. Only the copy
+ * is bracketed, so readers never wait for port I/O of a pass.
+ */
+void stats_commit(struct stats *s, struct stats *counters)
+{
+    size_t from = offsetof(struct stats, nports);
+    size_t to = offsetof(struct stats, state);
+
+    stats_begin(s);
+    memcpy((char *)s + from, (char *)counters + from, to - from);
+    stats_end(s);
+}
+
+/*
+ * Wait a little before the next try of a copy. Returns -1 when there is
+ * no point, we tried long enough or the controller is gone.
+ */
+static int stats_retry(struct stats *s, int n)
+{
+    struct timespec ts;
+
+    if (n >= STATTRIES || (kill(s->pid, 0) < 0 && errno == ESRCH))
+        return -1;
+    ts.tv_sec = 0;
+    ts.tv_nsec = 100000;
+    nanosleep(&ts, NULL);
+    return 0;
+}
+
+/*
+ * Take a consistent copy, returns the number of retries needed or -1 when
+ * the copy may be torn
+ */
+int stats_read(struct stats *s, struct stats *copy)
+{
+    uint32_t seq;
+    int n = 0;
+
+    for (;;) {
+        seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        memcpy(copy, s, sizeof(struct stats));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (!(seq & 1) && __atomic_load_n(&s->seq, __ATOMIC_RELAXED) == seq)
+            return n;
+        if (stats_retry(s, ++n) < 0)
+            return -1;
+    }
+}
+
+/*
+ * Remove the segment when the controller ends
+ */
+void stats_close()
+{
+    if (shared == NULL)
+        return;
+    munmap(shared, sizeof(struct stats));
+    shm_unlink(STATSHM);
+    shared = NULL;
+}
+
+/*
+ * Publish a port sample. Readers are only woken when the sample differs
+ * from the one published before.
+ */
+void stats_publish(struct stats *s, int port, unsigned char *c,
+                   unsigned char flags, unsigned char dtmf, uint64_t us)
+{
+    struct portstate *ps = &s->state[port];
+
+    if (ps->seq && ps->status == c[0] && ps->data == c[1] &&
+            ps->flags == flags)
+        return;
+
+    __atomic_store_n(&ps->seq, ps->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    ps->us = us;
+    ps->status = c[0];
+    ps->data = c[1];
+    ps->flags = flags;
+    ps->dtmf = dtmf;
+    __atomic_store_n(&ps->seq, ps->seq + 1, __ATOMIC_RELEASE);
+
+    syscall(SYS_futex, &ps->seq, FUTEX_WAKE, 0x7fffffff, NULL, NULL, 0);
+}
+
+/*
+ * Take a consistent copy of a port sample, returns its sequence. An odd
+ * sequence flags a copy that may be torn.
+ */
+uint32_t stats_state(struct stats *s, int port, struct portstate *copy)
+{
+    struct portstate *ps = &s->state[port];
+    uint32_t seq;
+    int n = 0;
+
+    for (;;) {
+        seq = __atomic_load_n(&ps->seq, __ATOMIC_ACQUIRE);
+        memcpy(copy, ps, sizeof(struct portstate));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (!(seq & 1) && __atomic_load_n(&ps->seq, __ATOMIC_RELAXED) == seq)
+            return seq;
+        if (stats_retry(s, ++n) < 0)
+            return seq | 1;
+    }
+}
+
+/*
+ * Sleep until the port sample moves on from seq or ms passed.
+ * Returns 0 on a change, -1 on timeout.
+ */
+int stats_wait(struct stats *s, int port, uint32_t seq, int ms)
+{
+    struct portstate *ps = &s->state[port];
+    struct timespec ts;
+
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+
+    while (__atomic_load_n(&ps->seq, __ATOMIC_ACQUIRE) == seq) {
+        if (syscall(SYS_futex, &ps->seq, FUTEX_WAIT, seq, &ts, NULL, 0) < 0
+                && errno == ETIMEDOUT)
+            return -1;
+    }
+    return 0;
+}
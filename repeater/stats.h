@@ -0,0 +1,181 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Live counters
+ *
+ * The controller keeps its counters in its own memory and publishes them
+ * to a POSIX shared memory segment once per loop pass. It is the only
+ * writer and brackets nothing but the copy with stats_begin() and
+ * stats_end(), a sequence lock readers use to take consistent copies at
+ * any rate without ever calling into the controller. A reader gives up
+ * after STATTRIES or when the controller is gone and keeps a torn copy.
+ *
+ * The latest port sample of every port is published as well, with its own
+ * sequence counter that doubles as a futex so readers can sleep until the
+ * port changes.
+ */
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define STATSHM     "/repeater-stats"
+#define STATMAGIC   0x54415453  /* "STAT" */
+#define STATVERSION 11
+#define STATPORTS   4           /* Same as MAXPORTS */
+#define STALLBASE   10          /* Late passes histogram starts at 10 ms */
+#define STALLBUCKETS 12         /* Doubling up to 20 s and beyond */
+#define SAMPLEMODES 3           /* Fast, decaying and idle sampling */
+#define STATTRIES   100         /* Copies a reader tries, 100 us apart */
+
+/* Runs of one of the scripts of a port */
+struct scriptstats {
+    uint64_t    fails;          /* Runs with a non zero exit */
+    int64_t     lastexit;       /* Exit code, minus the signal if killed */
+    uint64_t    lastus;         /* Wall time of the last run in us */
+    uint64_t    maxus;
+    uint64_t    totalus;
+    uint64_t    unkeyus;        /* Last time from exit to unkey in us */
+    uint64_t    maxunkeyus;
+};
+
+/* Sleeps of the loop taken in one sampling mode */
+struct samplestats {
+    uint64_t    wakeups;
+    uint64_t    us;             /* Time spent in the mode */
+    uint64_t    edges;          /* Input edges seen */
+    uint64_t    maxlatus;       /* Worst time from an edge to its sample */
+};
+
+/* Software PWM of a port */
+struct pwmstats {
+    uint32_t    hz;             /* 0 if the port has none */
+    uint32_t    duty;           /* Being driven, permille */
+    uint64_t    edges;          /* Level changes written */
+    uint64_t    lateus;         /* Sum of how late they were */
+    uint64_t    maxlateus;
+    uint64_t    late;           /* Edges late by more than 1 ms */
+    uint64_t    maxholdus;      /* Longest another write waited for an edge */
+    uint64_t    deferred;       /* Edges held back for another write */
+    uint64_t    keywrites;      /* Loop writes that changed KEY or MUTE */
+    uint64_t    keyus;          /* Their time from start to done, summed */
+    uint64_t    maxkeyus;
+    uint64_t    errors;         /* Writes that failed */
+};
+
+/* CW beacon of a port, times of the key changes against their deadlines */
+struct beaconstats {
+    uint32_t    wpm;            /* 0 if the port has none */
+    uint32_t    unitus;         /* Length of a dit */
+    uint64_t    sends;          /* Times the text was sent */
+    uint64_t    edges;          /* Key changes written */
+    uint64_t    lateus;         /* Sum of how late they were */
+    uint64_t    maxlateus;
+    uint64_t    late;           /* Key changes late by more than 1 ms */
+    uint64_t    maxerrus;       /* Worst element or gap off its length */
+    uint64_t    errors;         /* Writes that failed */
+};
+
+struct portstats {
+    char        name[16];
+    uint64_t    keyups;         /* Transmitter key ups */
+    uint64_t    kerchunks;      /* Unkeys through the shortkey path */
+    uint64_t    txus;           /* Transmitter keyed time in us */
+    uint64_t    irlpus;         /* Keyed time last keyed by IRLP */
+    uint64_t    localus;        /* Keyed time last keyed locally */
+    uint64_t    cts;            /* Courtesy tones played */
+    uint64_t    ids;            /* IDs played */
+    uint64_t    anns;           /* Announcements played */
+    uint64_t    fanus;          /* Fan on time in us */
+    uint64_t    cosglitches;    /* Bursts the input filters rejected */
+    uint64_t    dtmfglitches;
+    uint64_t    porterrors;     /* Failed reads and writes of the device */
+    uint64_t    outages;        /* Times the port was taken out of service */
+    uint64_t    recoveries;     /* Times it came back */
+    uint64_t    downus;         /* Time out of service */
+    uint64_t    maxdownus;      /* Longest outage */
+    uint64_t    downsince;      /* Start of the current outage in ms, or 0 */
+    struct scriptstats ct;      /* Courtesy script */
+    struct scriptstats id;      /* ID script */
+    struct scriptstats an;      /* Announce script */
+    struct pwmstats pwm;
+    struct beaconstats beacon;
+};
+
+/* Flags derived from a port sample */
+#define PS_COS      0x01
+#define PS_IRLPKEY  0x02
+#define PS_KEY      0x04
+#define PS_MUTE     0x08
+#define PS_FAN      0x10
+#define PS_CTCSS    0x20
+#define PS_AUX5     0x40
+#define PS_DTMF     0x80
+
+struct portstate {
+    uint32_t    seq;            /* Odd while updating, futex word */
+    uint32_t    pad;
+    uint64_t    us;             /* Time of the sample */
+    unsigned char status;       /* Status register */
+    unsigned char data;         /* Data register */
+    unsigned char flags;        /* PS_ flags */
+    unsigned char dtmf;         /* DTMF nibble */
+};
+
+struct stats {
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    seq;            /* Odd while the controller updates */
+    uint32_t    nports;
+    pid_t       pid;            /* The controller */
+    uint64_t    started;        /* Start time in ms since the epoch */
+    uint64_t    loops;          /* Loop passes */
+    uint64_t    overruns;       /* Passes late by more than 5 ms */
+    uint64_t    maxgapus;       /* Longest time between passes */
+    uint64_t    wdtrips;        /* Stalls the watchdog stepped in */
+    uint64_t    stallhist[STALLBUCKETS]; /* Late passes by gap */
+    struct samplestats sample[SAMPLEMODES];
+    uint32_t    period;         /* Current sampling period in ms */
+    uint32_t    fastms;         /* and the configured ones */
+    uint32_t    idlems;
+    struct portstats port[STATPORTS];
+    struct portstate state[STATPORTS];
+};
+
+struct stats *stats_open();
+struct stats *stats_map();
+void stats_begin(struct stats *s);
+void stats_end(struct stats *s);
+void stats_commit(struct stats *s, struct stats *counters);
+int  stats_read(struct stats *s, struct stats *copy);
+void stats_close();
+void stats_publish(struct stats *s, int port, unsigned char *c,
+                   unsigned char flags, unsigned char dtmf, uint64_t us);
+uint32_t stats_state(struct stats *s, int port, struct portstate *copy);
+int  stats_wait(struct stats *s, int port, uint32_t seq, int ms);
@@ -0,0 +1,184 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+#include "log.h"
+#include "supervise.h"
+
+/* Record our pid in the pidfile */
+static void pidfile_write(int fd)
+{
+    char buf[16];
+    int n;
+
+    n = snprintf(buf, sizeof(buf), "%d\n", (int)getpid());
+    if (ftruncate(fd, 0) < 0 || pwrite(fd, buf, n, 0) != n)
+        fprintf(stderr, "Can't write pidfile: %s\n", strerror(errno));
+}
+
+/*
+ * Take the pidfile. Returns the locked descriptor, held for the life of
+ * the process and inherited by the controller, or -1 if another process
+ * holds it.
+ */
+int pidfile_lock(const char *path)
+{
+    char buf[16];
+    int fd, n;
+
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Can't open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        n = pread(fd, buf, sizeof(buf) - 1, 0);
+        buf[n > 0 ? n : 0] = '\0';
+        fprintf(stderr, "Already running, pid %s", n > 0 ? buf : "?\n");
+        close(fd);
+        return -1;
+    }
+    pidfile_write(fd);
+    return fd;
+}
+
+/*
+ * Take a pidfile handed over by the controller we replace, the lock comes
+ * with the descriptor
+ */
+void pidfile_adopt(int fd)
+{
+    pidfile_write(fd);
+}
+
+/* Milliseconds of a monotonic clock */
+static double mnow()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/*
+ * Run the controller under supervision. Returns 0 in the controller, the
+ * supervisor itself only returns with an error before the first fork.
+ * The safe function puts the outputs in a safe state after the controller
+ * died on us.
+ */
+int supervise(int pidfd, void (*safe)(void))
+{
+    sigset_t set, old;
+    siginfo_t si;
+    pid_t pid = 0;
+    double starts[RESPAWNS];
+    int n = 0, s, stopping = 0;
+    char buf[LOGTXT];
+
+    memset(starts, 0, sizeof(starts));
+    sigemptyset(&set);
+    sigaddset(&set, SIGCHLD);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGHUP);
+    if (sigprocmask(SIG_BLOCK, &set, &old) < 0)
+        return -1;
+
+    while (1) {
+        /* Start the controller, backing off if it keeps dying */
+        if (!pid) {
+            if (starts[n % RESPAWNS] &&
+                    mnow() - starts[n % RESPAWNS] < RESPAWNWIN) {
+                do_log("Supervisor: controller keeps dying, backing off");
+                usleep(RESPAWNDLY * 1000);
+            }
+            starts[n++ % RESPAWNS] = mnow();
+
+            fflush(NULL);       /* Or the controller repeats our output */
+            pid = fork();
+            if (pid == 0) {
+                sigprocmask(SIG_SETMASK, &old, NULL);
+                return 0;
+            }
+            if (pid < 0) {
+                snprintf(buf, sizeof(buf), "Supervisor: fork: %s",
+                         strerror(errno));
+                do_log(buf);
+                pid = 0;
+                usleep(RESPAWNDLY * 1000);
+                continue;
+            }
+        }
+
+        if (sigwaitinfo(&set, &si) < 0)
+            continue;
+
+        switch (si.si_signo) {
+        case SIGTERM:
+        case SIGINT:
+            stopping = 1;
+            kill(pid, SIGTERM);
+            break;
+        case SIGHUP:
+            kill(pid, SIGHUP);
+            break;
+        case SIGCHLD:
+            if (waitpid(pid, &s, WNOHANG) != pid)
+                break;
+            pid = 0;
+            if (stopping) {
+                close(pidfd);
+                exit(0);
+            }
+            if (WIFEXITED(s) && WEXITSTATUS(s) == HANDOFFEXIT) {
+                do_log("Supervisor: controller handed off, leaving");
+                close(pidfd);
+                exit(0);
+            }
+            if (WIFSIGNALED(s))
+                snprintf(buf, sizeof(buf), "Supervisor: controller killed "
+                         "by signal %d, restarting", WTERMSIG(s));
+            else
+                snprintf(buf, sizeof(buf), "Supervisor: controller exited "
+                         "with %d, restarting", WEXITSTATUS(s));
+            do_log(buf);
+            safe();
+            break;
+        }
+    }
+}
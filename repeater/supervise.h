@@ -0,0 +1,51 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Supervision
+ *
+ * A pidfile held with flock() keeps a second controller from starting.
+ * In supervisor mode the process holding it forks the controller and
+ * starts a new one as soon as the old one dies. SIGTERM and SIGINT stop
+ * the controller gracefully and the supervisor with it, SIGHUP is passed
+ * on. A controller that handed over to a new one exits with HANDOFFEXIT,
+ * the supervisor then leaves as well and the outputs alone.
+ */
+
+#include <sys/types.h>
+
+#define PIDFILE     "/tmp/repeater.pid"
+#define RESPAWNS    5           /* Restarts within RESPAWNWIN ms ... */
+#define RESPAWNWIN  10000
+#define RESPAWNDLY  1000        /* ... before we wait this long, in ms */
+#define HANDOFFEXIT 75          /* Exit status after a handoff */
+
+int pidfile_lock(const char *path);
+void pidfile_adopt(int fd);
+int supervise(int pidfd, void (*safe)(void));
@@ -0,0 +1,187 @@
+/* Copyright (c) 2026, Adi Linden <adi@adis.ca>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the 
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may 
+ *    be used to endorse or promote products derived from this software 
+ *    without specific prior written permission.
+ *    
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "irlpdev.h"
+#include "portctl_lib.h"
+#include "stats.h"
+#include "log.h"
+#include "pwm.h"
+#include "watchdog.h"
+
+/* A port as the watchdog sees it, with a handle of its own */
+struct wdport {
+    struct irlpdev  dev;
+    int             id;
+    unsigned char   clr;        /* KEY low and MUTE on */
+    char            name[16];
+};
+
+static struct wdport wdports[MAXPORTS];
+static int nwdports = 0;
+static pthread_t watcher;
+static int running = 0;
+static int budget = 0;
+static uint64_t beat = 0;       /* Last beat of the loop, ms */
+static uint64_t tripbeat = 0;   /* The beat we tripped on */
+static int tripped = 0;
+
+/* Milliseconds of a monotonic clock */
+static uint64_t mono_ms()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Open a second handle to a port for use when the loop is stuck
+ */
+int wd_add(struct port *p)
+{
+    struct wdport *w;
+
+    if (nwdports >= MAXPORTS)
+        return -1;
+    w = &wdports[nwdports];
+    if (irlpdev_dup(&p->dev, &w->dev) < 0)
+        return -1;
+    w->id = p->id;
+    w->clr = p->pins.key | p->pins.mute;
+    snprintf(w->name, sizeof(w->name), "%s", p->name);
+    ++nwdports;
+    return 0;
+}
+
+/*
+ * Close the handle of a port out of service so the device can go, and
+ * open it again once the port is back. These run on the loop, which is
+ * beating then, so the watchdog does not trip on the handle meanwhile.
+ */
+void wd_pause(int id)
+{
+    int i;
+
+    for (i = 0; i < nwdports; ++i)
+        if (wdports[i].id == id) {
+            pwm_begin(id);
+            irlpdev_close(&wdports[i].dev);
+            pwm_end(id);
+        }
+}
+
+void wd_resume(struct port *p)
+{
+    int i;
+
+    for (i = 0; i < nwdports; ++i)
+        if (wdports[i].id == p->id && wdports[i].dev.fd < 0) {
+            pwm_begin(p->id);
+            irlpdev_redup(&p->dev, &wdports[i].dev);
+            pwm_end(p->id);
+        }
+}
+
+void wd_beat()
+{
+    __atomic_store_n(&beat, mono_ms(), __ATOMIC_RELEASE);
+}
+
+void wd_budget(int ms)
+{
+    __atomic_store_n(&budget, ms, __ATOMIC_RELAXED);
+}
+
+/*
+ * Called by the loop, returns how long it was stalled in ms once after
+ * the watchdog stepped in, 0 otherwise
+ */
+int wd_tripped()
+{
+    if (!__atomic_load_n(&tripped, __ATOMIC_ACQUIRE))
+        return 0;
+    __atomic_store_n(&tripped, 0, __ATOMIC_RELEASE);
+    return mono_ms() - tripbeat;
+}
+
+/*
+ * The watchdog thread
+ */
+static void *wd_watch(void *arg)
+{
+    struct timespec tim;
+    uint64_t b, now;
+    char buf[LOGTXT];
+    int i;
+
+    tim.tv_sec = 0;
+    tim.tv_nsec = WDPERIOD * 1000000;
+    while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        nanosleep(&tim, NULL);
+        if (__atomic_load_n(&tripped, __ATOMIC_ACQUIRE))
+            continue;
+        b = __atomic_load_n(&beat, __ATOMIC_ACQUIRE);
+        now = mono_ms();
+        if (now - b <= __atomic_load_n(&budget, __ATOMIC_RELAXED))
+            continue;
+
+        for (i = 0; i < nwdports; ++i)
+            force_irlpdev(&wdports[i].dev, 0, wdports[i].clr);
+        tripbeat = b;
+        __atomic_store_n(&tripped, 1, __ATOMIC_RELEASE);
+        snprintf(buf, sizeof(buf), "Watchdog: loop stalled for %d ms, "
+                 "unkeyed and muted", (int)(now - b));
+        do_log(buf);
+    }
+    return NULL;
+}
+
+int wd_start(int ms)
+{
+    wd_budget(ms);
+    wd_beat();
+    running = 1;
+    if (pthread_create(&watcher, NULL, wd_watch, NULL)) {
+        running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void wd_stop()
+{
+    if (!running)
+        return;
+    __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+    pthread_join(watcher, NULL);
+}